@@ -0,0 +1,108 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "indexed_heap.hpp"
+
+/**
+ * @brief Ready queue for dynamic priority, where every waiting task ages at once
+ *
+ * `age()` decreases all priorities by one, but never below zero, and raises negative priorities to zero.
+ * Rather than visiting every task, priorities are stored relative to `epoch` (the number of `age()`s so far),
+ * and a task moves to `zeros` once its priority reaches zero, which happens at most once per `push`.
+ * A task pushed with a negative priority stays in `positives` until the next `age()`, and is taken before any zero.
+ *
+ * The task with the smallest priority is popped first. Ties are broken by `Less`.
+ */
+template <typename T, typename Less>
+class AgingQueue
+{
+protected:
+    struct Entry {
+        T item;
+        /** priority + epoch, i.e. the epoch when the priority will reach zero */
+        long long base;
+    };
+
+    struct BaseLess {
+        Less less;
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            if (a.base != b.base) {
+                return a.base < b.base;
+            }
+            return this->less(a.item, b.item);
+        }
+    };
+
+    struct ItemLess {
+        Less less;
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return this->less(a.item, b.item);
+        }
+    };
+
+    /** tasks whose priorities are positive, or negative if pushed after the last `age()` */
+    IndexedHeap<Entry, BaseLess> positives;
+    /** tasks whose priorities are zero */
+    IndexedHeap<Entry, ItemLess> zeros;
+
+    long long epoch = 0;
+
+public:
+    AgingQueue(Less less = Less()) : positives(BaseLess{less}), zeros(ItemLess{less}) {}
+
+    /** Copy `other`, but break ties by `less`, see `IndexedHeap` */
+    AgingQueue(const AgingQueue &other, Less less)
+        : positives(other.positives, BaseLess{less}), zeros(other.zeros, ItemLess{less}), epoch(other.epoch) {}
+
+    bool empty() const
+    {
+        return this->positives.empty() && this->zeros.empty();
+    }
+
+    size_t size() const
+    {
+        return this->positives.size() + this->zeros.size();
+    }
+
+    void push(const T &item, int priority)
+    {
+        if (priority == 0) {
+            this->zeros.push(Entry{item, this->epoch});
+        } else {
+            this->positives.push(Entry{item, this->epoch + priority});
+        }
+    }
+
+    /**
+     * @brief Take the task with the smallest priority
+     *
+     * @param priority (output) its current priority
+     */
+    T pop(int &priority)
+    {
+        assert(!this->empty());
+
+        if (!this->zeros.empty() && (this->positives.empty() || this->positives.top().base >= this->epoch)) {
+            priority = 0;
+            return this->zeros.pop().item;
+        } else {
+            const auto entry = this->positives.pop();
+            priority = (int)(entry.base - this->epoch);
+            return entry.item;
+        }
+    }
+
+    /** Decrease every task's priority by one, but not below zero, and raise negative ones to zero */
+    void age()
+    {
+        this->epoch++;
+
+        while (!this->positives.empty() && this->positives.top().base <= this->epoch) {
+            this->zeros.push(this->positives.pop());
+        }
+    }
+};
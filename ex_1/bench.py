@@ -0,0 +1,140 @@
+"""
+Benchmark `ex_1.cpp` and `ex_1-event.cpp` on synthetic workloads.
+
+    python bench.py [--sizes 1e3,1e4,1e5,1e6,1e7] [--seed 0] [-- generator options…]
+
+Both programs are built with `bench_report.hpp` forced in, inputs are made by `gen_workload.cpp`,
+and every algorithm is run at every size by the implementations supporting it. One CSV row is printed per run:
+
+- ns_per_event: CPU time (user + sys) / (tasks + records)
+- peak_rss_mb: the maximum resident set size (`VmHWM`)
+- allocs_per_task: `operator new` calls / tasks
+
+Runs that time out (`--timeout`) or fail are reported by `status` with empty measurements,
+and larger sizes of the same implementation and algorithm are skipped.
+"""
+
+from argparse import ArgumentParser
+from os import wait4
+from pathlib import Path
+from signal import SIGKILL
+from subprocess import PIPE, Popen, run
+from sys import stderr
+from threading import Timer
+from typing import NamedTuple, Union
+
+HERE = Path(__file__).parent
+
+IMPLEMENTATIONS = ['ex_1', 'ex_1-event']
+ALGORITHMS = [1, 2, 3, 4, 5, 6, 7]
+# `ex_1.cpp` does not implement multilevel feedback queues (6) or completely fair scheduling (7).
+UNSUPPORTED = {('ex_1', 6), ('ex_1', 7)}
+
+
+class Measurement(NamedTuple):
+    records: int
+    cpu_s: float
+    peak_rss_mb: float
+    allocations: int
+
+
+def build(source: Path, output: Path, cxxflags: list[str], with_report: bool) -> None:
+    flags = ['-include', str(HERE / 'bench_report.hpp')] if with_report else []
+    run(['g++', *cxxflags, *flags, '-o', str(output), str(source)], check=True)
+
+
+def measure(program: Path, workload: Path, timeout: float) -> Union[Measurement, str]:
+    """Run `program` with `workload` as stdin, or return `'timeout'` or `'failed'`"""
+
+    with workload.open('rb') as stdin:
+        process = Popen([str(program)], stdin=stdin, stdout=PIPE, stderr=PIPE)
+
+    killed = False
+
+    def kill():
+        nonlocal killed
+        killed = True
+        process.send_signal(SIGKILL)
+
+    timer = Timer(timeout, kill)
+    timer.start()
+
+    # Count records while they are being printed, without keeping them.
+    records = 0
+    assert process.stdout is not None and process.stderr is not None
+    while chunk := process.stdout.read(1 << 20):
+        records += chunk.count(b'\n')
+    errors = process.stderr.read().decode()
+
+    _, status, usage = wait4(process.pid, 0)
+    process.returncode = status
+    timer.cancel()
+
+    if killed:
+        return 'timeout'
+    if status != 0:
+        print(errors, end='', file=stderr)
+        return 'failed'
+
+    report = dict(line.split(': ') for line in errors.splitlines() if ': ' in line)
+    return Measurement(
+        records=records,
+        cpu_s=usage.ru_utime + usage.ru_stime,
+        peak_rss_mb=int(report['peak_rss_kb']) / 1024,
+        allocations=int(report['allocations']),
+    )
+
+
+def cli():
+    parser = ArgumentParser(description='Benchmark the schedulers on synthetic workloads.')
+    parser.add_argument('--sizes', default='1e3,1e4,1e5,1e6,1e7',
+                        help='numbers of tasks, comma-separated')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--timeout', type=float, default=300, help='seconds per run')
+    parser.add_argument('--build-dir', type=Path, default=HERE / '_bench')
+    parser.add_argument('--cxxflags', default='-std=c++17 -O2 -DNDEBUG')
+    parser.add_argument('generator_options', nargs='*',
+                        help='passed to gen_workload, e.g. --arrivals=bursty')
+    args = parser.parse_args()
+
+    sizes = [int(float(s)) for s in args.sizes.split(',')]
+    cxxflags = args.cxxflags.split()
+
+    build_dir: Path = args.build_dir
+    build_dir.mkdir(exist_ok=True)
+    generator = build_dir / 'gen_workload'
+    build(HERE / 'gen_workload.cpp', generator, cxxflags, with_report=False)
+    programs = {}
+    for name in IMPLEMENTATIONS:
+        programs[name] = build_dir / name
+        build(HERE / f'{name}.cpp', programs[name], cxxflags, with_report=True)
+
+    print('implementation,algorithm,n,status,records,cpu_s,ns_per_event,peak_rss_mb,allocs_per_task', flush=True)
+    given_up: set[tuple[str, int]] = set()
+    for n in sizes:
+        for algorithm in ALGORITHMS:
+            workload = build_dir / 'workload.txt'
+            with workload.open('wb') as f:
+                run([str(generator), f'--n={n}', f'--seed={args.seed}', f'--algorithm={algorithm}',
+                     *args.generator_options], stdout=f, check=True)
+
+            for name in IMPLEMENTATIONS:
+                if (name, algorithm) in given_up or (name, algorithm) in UNSUPPORTED:
+                    continue
+
+                print(f'{name}, algorithm {algorithm}, n = {n}…', file=stderr, flush=True)
+                m = measure(programs[name], workload, args.timeout)
+                if isinstance(m, str):
+                    given_up.add((name, algorithm))
+                    print(f'{name},{algorithm},{n},{m},,,,,', flush=True)
+                    continue
+
+                print(f'{name},{algorithm},{n},ok,{m.records},{m.cpu_s:.3f},'
+                      f'{1e9 * m.cpu_s / (n + m.records):.1f},{m.peak_rss_mb:.1f},'
+                      f'{m.allocations / n:.2f}', flush=True)
+
+            workload.unlink()
+
+
+if __name__ == '__main__':
+    cli()
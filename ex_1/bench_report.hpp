@@ -0,0 +1,70 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Report heap allocations and peak memory at exit, for benchmarking
+ *
+ * Not included by any program. Force it in when building, e.g. `g++ -include bench_report.hpp ex_1.cpp`,
+ * and these lines are printed to stderr at exit:
+ *
+ * - `allocations: N`, the number of `operator new` calls
+ * - `peak_rss_kb: N`, `VmHWM` in `/proc/self/status`
+ *
+ * `getrusage` is not used for the latter, because its `ru_maxrss` includes the parent's memory before `exec`.
+ */
+
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static std::atomic<unsigned long long> bench_report_n_allocations(0);
+
+void *operator new(size_t size)
+{
+    bench_report_n_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+/** @return 0 if unknown */
+static long bench_report_peak_rss_kb()
+{
+    FILE *status = fopen("/proc/self/status", "r");
+    if (status == NULL) {
+        return 0;
+    }
+
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), status) != NULL) {
+        if (strncmp(line, "VmHWM:", strlen("VmHWM:")) == 0) {
+            kb = atol(line + strlen("VmHWM:"));
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+}
+
+/** Constructed before anything in the program, so destructed after everything */
+static struct BenchReport {
+    ~BenchReport()
+    {
+        fprintf(stderr, "allocations: %llu\n", bench_report_n_allocations.load());
+        fprintf(stderr, "peak_rss_kb: %ld\n", bench_report_peak_rss_kb());
+    }
+} bench_report;
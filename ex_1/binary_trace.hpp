@@ -0,0 +1,278 @@
+#pragma once
+
+#include <assert.h>
+#include <fcntl.h>
+#include <initializer_list>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "varint.hpp"
+
+/**
+ * @file
+ * @brief A compact binary format for tasks and plans
+ *
+ * A trace is a header followed by rows, each of which has `n_fields` integers.
+ *
+ * Header (24 bytes, little-endian):
+ *
+ * | offset | size | field                                                  |
+ * | -----: | ---: | ------------------------------------------------------ |
+ * |      0 |    4 | magic `SCHD`                                           |
+ * |      4 |    1 | version, currently 1                                   |
+ * |      5 |    1 | kind, see `BinaryTraceKind`                            |
+ * |      6 |    1 | `n_fields`                                             |
+ * |      7 |    1 | reserved, 0                                            |
+ * |      8 |    4 | algorithm (signed), 0 if not applicable                |
+ * |     12 |    4 | reserved, 0                                            |
+ * |     16 |    8 | the number of rows, all ones if unknown                |
+ *
+ * Each field of a row is stored as the difference from the same field in the previous row
+ * (the first row is compared to zeros), zigzag-encoded, then as a LEB128 varint.
+ * As ids and times mostly increase a little per row, most fields take one byte.
+ *
+ * If the count is unknown (written to a pipe or appended to a file), rows continue to the end of the data.
+ */
+
+#define BINARY_TRACE_VERSION 1
+#define BINARY_TRACE_HEADER_SIZE 24
+#define BINARY_TRACE_UNKNOWN_COUNT UINT64_MAX
+
+enum BinaryTraceKind {
+    /** `id/arrive_at/duration/priority/quantum` */
+    TaskList = 1,
+    /** `id/start_at/end_at/priority[/core]`, without the index */
+    RecordList = 2,
+};
+
+struct BinaryTraceHeader {
+    BinaryTraceKind kind;
+    int n_fields;
+    int algorithm;
+    uint64_t count;
+};
+
+/**
+ * @brief Reads a binary trace from a file descriptor
+ *
+ * Regular files are mapped into memory and decoded in place.
+ * Others (e.g. pipes) are read into a buffer first.
+ */
+class BinaryTraceReader
+{
+protected:
+    const uint8_t *data;
+    size_t size;
+    /** the next byte in `data` */
+    size_t pos;
+
+    /** the mapping, if mapped */
+    void *mapped;
+    /** the buffer, if not mapped */
+    std::vector<uint8_t> buffer;
+
+    BinaryTraceHeader header_;
+    /** whether the header is well-formed and no row read so far is truncated */
+    bool valid;
+    uint64_t n_read;
+    /** the last row */
+    std::vector<int64_t> last;
+
+public:
+    BinaryTraceReader(int fd) : data(NULL), size(0), pos(0), mapped(MAP_FAILED), valid(false), n_read(0)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            this->mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+
+        if (this->mapped != MAP_FAILED) {
+            madvise(this->mapped, st.st_size, MADV_SEQUENTIAL);
+            this->data = (const uint8_t *)this->mapped;
+            this->size = st.st_size;
+        } else {
+            uint8_t chunk[1 << 16];
+            ssize_t n;
+            while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+                this->buffer.insert(this->buffer.end(), chunk, chunk + n);
+            }
+            this->data = this->buffer.data();
+            this->size = this->buffer.size();
+        }
+
+        this->valid = this->read_header();
+        if (this->valid) {
+            this->last.assign(this->header_.n_fields, 0);
+        }
+    }
+
+    ~BinaryTraceReader()
+    {
+        if (this->mapped != MAP_FAILED) {
+            munmap(this->mapped, this->size);
+        }
+    }
+
+    BinaryTraceReader(const BinaryTraceReader &) = delete;
+    BinaryTraceReader &operator=(const BinaryTraceReader &) = delete;
+
+    /** Whether the header is well-formed and of a known version, and no row read so far is truncated */
+    bool ok() const
+    {
+        return this->valid;
+    }
+
+    const BinaryTraceHeader &header() const
+    {
+        return this->header_;
+    }
+
+    /**
+     * @brief Read a row into `fields`, whose size must be `n_fields`
+     *
+     * @return `false` if nothing is left, or if the data ends before the row (or before `count` rows) does,
+     * in which case `ok()` becomes `false` as well.
+     */
+    bool read_row(std::initializer_list<int *> fields)
+    {
+        assert(fields.size() == (size_t)this->header_.n_fields);
+
+        if (!this->valid) {
+            return false;
+        }
+        if (this->header_.count == BINARY_TRACE_UNKNOWN_COUNT
+                ? this->pos == this->size
+                : this->n_read == this->header_.count) {
+            return false;
+        }
+
+        size_t i = 0;
+        for (auto &&f : fields) {
+            uint64_t v;
+            if (!this->read_varint(v)) {
+                this->valid = false;
+                return false;
+            }
+            this->last[i] += unzigzag(v);
+            *f = (int)this->last[i];
+            i++;
+        }
+        this->n_read++;
+
+        return true;
+    }
+
+protected:
+    bool read_header()
+    {
+        if (this->size < BINARY_TRACE_HEADER_SIZE || memcmp(this->data, "SCHD", 4) != 0 ||
+            this->data[4] != BINARY_TRACE_VERSION) {
+            return false;
+        }
+
+        this->header_.kind = (BinaryTraceKind)this->data[5];
+        this->header_.n_fields = this->data[6];
+        this->header_.algorithm = (int32_t)load_le(this->data + 8, 4);
+        this->header_.count = load_le(this->data + 16, 8);
+        this->pos = BINARY_TRACE_HEADER_SIZE;
+
+        return this->header_.n_fields > 0;
+    }
+
+    /** @return `false` if the data ends within the varint, or it is longer than 64 bits */
+    bool read_varint(uint64_t &value)
+    {
+        return decode_varint(this->data, this->size, this->pos, value);
+    }
+
+    static uint64_t load_le(const uint8_t *p, int n_bytes)
+    {
+        uint64_t v = 0;
+        for (int i = n_bytes - 1; i >= 0; i--) {
+            v = (v << 8) | p[i];
+        }
+        return v;
+    }
+};
+
+/**
+ * @brief Writes a binary trace to a `FILE`, row by row
+ *
+ * The count in the header is filled in by `finish` if the file is seekable, and left unknown otherwise.
+ * A file opened for appending counts as not seekable, because writes would go to its end regardless.
+ */
+class BinaryTraceWriter
+{
+protected:
+    FILE *file;
+    int n_fields;
+    /** where the header starts, -1 if not seekable */
+    long header_at;
+    uint64_t n_written;
+    /** the last row */
+    std::vector<int64_t> last;
+    /** the bytes of the varint being written */
+    std::vector<uint8_t> varint;
+
+public:
+    BinaryTraceWriter(FILE *file, BinaryTraceKind kind, int n_fields, int algorithm = 0)
+        : file(file), n_fields(n_fields), header_at(-1), n_written(0), last(n_fields, 0)
+    {
+        const int flags = fcntl(fileno(file), F_GETFL);
+        if (flags != -1 && (flags & O_APPEND) == 0) {
+            this->header_at = ftell(file);
+        }
+        assert(0 < n_fields && n_fields < 256);
+
+        uint8_t header[BINARY_TRACE_HEADER_SIZE] = {'S', 'C', 'H', 'D', BINARY_TRACE_VERSION, (uint8_t)kind, (uint8_t)n_fields, 0};
+        store_le(header + 8, (uint32_t)algorithm, 4);
+        store_le(header + 16, BINARY_TRACE_UNKNOWN_COUNT, 8);
+        fwrite(header, 1, sizeof(header), this->file);
+    }
+
+    void write_row(std::initializer_list<int> fields)
+    {
+        assert(fields.size() == (size_t)this->n_fields);
+
+        size_t i = 0;
+        for (auto &&f : fields) {
+            this->write_varint(zigzag((int64_t)f - this->last[i]));
+            this->last[i] = f;
+            i++;
+        }
+        this->n_written++;
+    }
+
+    /** Called after the last row */
+    void finish()
+    {
+        if (this->header_at >= 0 && fseek(this->file, this->header_at + 16, SEEK_SET) == 0) {
+            uint8_t count[8];
+            store_le(count, this->n_written, 8);
+            fwrite(count, 1, sizeof(count), this->file);
+            fseek(this->file, 0, SEEK_END);
+        }
+        fflush(this->file);
+    }
+
+protected:
+    void write_varint(uint64_t v)
+    {
+        this->varint.clear();
+        append_varint(this->varint, v);
+        fwrite(this->varint.data(), 1, this->varint.size(), this->file);
+    }
+
+    static void store_le(uint8_t *p, uint64_t v, int n_bytes)
+    {
+        for (int i = 0; i < n_bytes; i++) {
+            p[i] = v & 0xff;
+            v >>= 8;
+        }
+    }
+};
@@ -0,0 +1,102 @@
+"""
+Check that `ex_1-event --incremental` schedules a growing trace the same as scheduling it from scratch.
+
+    python check_incremental.py [--seeds 20] [--n 300] [--days 6] [--cxxflags '…']
+
+For every algorithm, event queue, snapshot interval and seed, a workload made by `gen_workload.cpp`
+is revealed day by day. Most tasks show up on the day they arrive, but some are reported a few days late,
+so a day can add tasks before those already scheduled. The last day is run twice, adding nothing.
+
+Each day runs as a new process that keeps its state in a file, like a daily job would,
+and its plan must equal a plain `ex_1-event` on the same input.
+Mismatches are printed, and the exit status is 1 if there are any.
+"""
+
+from argparse import ArgumentParser
+from pathlib import Path
+from random import Random
+from subprocess import run
+from sys import exit, stderr
+
+HERE = Path(__file__).parent
+
+ALGORITHMS = [1, 2, 3, 4, 5, 6, 7]
+EVENT_QUEUES = ['heap', 'calendar']
+SNAPSHOT_INTERVALS = [1, 20, 1000]
+
+
+def build(source: Path, output: Path, cxxflags: list[str]) -> None:
+    run(['g++', *cxxflags, '-o', str(output), str(source), '-lpthread'], check=True)
+
+
+def schedule(program: Path, workload: str, options: list[str]) -> str:
+    return run([str(program), *options], input=workload, capture_output=True, text=True, check=True).stdout
+
+
+def reveal(tasks: list[str], n_days: int, rng: Random) -> list[list[str]]:
+    """Split `tasks` (sorted by arrival) into what is known on each day, keeping their order"""
+
+    days = []
+    for i, _ in enumerate(tasks):
+        day = i * n_days // len(tasks)
+        if rng.random() < 0.15:
+            day = rng.randint(day, n_days - 1)
+        days.append(day)
+
+    return [[t for t, day in zip(tasks, days) if day <= d] for d in range(n_days)]
+
+
+def cli():
+    parser = ArgumentParser(description='Check incremental scheduling against scheduling from scratch.')
+    parser.add_argument('--seeds', type=int, default=20, help='workloads per algorithm')
+    parser.add_argument('--n', type=int, default=300, help='tasks per workload')
+    parser.add_argument('--days', type=int, default=6)
+    parser.add_argument('--build-dir', type=Path, default=HERE / '_check')
+    parser.add_argument('--cxxflags', default='-std=c++17 -O2',
+                        help='e.g. add -fsanitize=address,undefined')
+    args = parser.parse_args()
+
+    cxxflags = args.cxxflags.split()
+    build_dir: Path = args.build_dir
+    build_dir.mkdir(exist_ok=True)
+    generator = build_dir / 'gen_workload'
+    build(HERE / 'gen_workload.cpp', generator, cxxflags)
+    program = build_dir / 'ex_1-event'
+    build(HERE / 'ex_1-event.cpp', program, cxxflags)
+    state = build_dir / 'state.bin'
+
+    n_runs = 0
+    mismatches = 0
+    for algorithm in ALGORITHMS:
+        print(f'algorithm {algorithm}…', file=stderr, flush=True)
+
+        for seed in range(args.seeds):
+            # Bursty arrivals and short tasks, so that batches and preemptions are common
+            workload = schedule(generator, '', [f'--n={args.n}', f'--seed={seed}', f'--algorithm={algorithm}',
+                                                '--arrivals=bursty', '--rate=0.5', '--durations=uniform',
+                                                '--duration=1-12', '--priority=0-39', '--quantum=1-4'])
+            first_line, *tasks = workload.splitlines()
+            rng = Random(seed)
+            days = reveal(tasks, args.days, rng)
+            days.append(days[-1])
+
+            for queue in EVENT_QUEUES:
+                for interval in SNAPSHOT_INTERVALS:
+                    state.unlink(missing_ok=True)
+                    for d, known in enumerate(days):
+                        day_input = '\n'.join([first_line, *known]) + '\n'
+                        expected = schedule(program, day_input, [f'--event-queue={queue}'])
+                        actual = schedule(program, day_input, [f'--event-queue={queue}', f'--incremental={state}',
+                                                               f'--snapshot-interval={interval}'])
+                        n_runs += 1
+                        if actual != expected:
+                            mismatches += 1
+                            print(f'mismatch: algorithm {algorithm}, seed {seed}, --event-queue={queue}, '
+                                  f'--snapshot-interval={interval}, day {d}', flush=True)
+
+    print(f'{n_runs} incremental runs, {mismatches} mismatches')
+    exit(1 if mismatches > 0 else 0)
+
+
+if __name__ == '__main__':
+    cli()
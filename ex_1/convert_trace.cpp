@@ -0,0 +1,127 @@
+/**
+ * @file
+ * @brief Convert tasks and plans between the text format and the binary format (`binary_trace.hpp`)
+ *
+ * - `--to-binary=tasks`: input like the test cases → a binary task list
+ * - `--to-binary=plan`: output of `ex_1-event` → a binary record list
+ * - `--to-binary=plan-with-core`: output of `ex_1-event --cores=N` → a binary record list
+ * - `--to-text`: any binary trace → its text format
+ */
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binary_trace.hpp"
+#include "input_parser.hpp"
+
+using namespace std;
+
+void print_usage(const char *program)
+{
+    cerr << "Usage: " << program << " --to-binary=tasks|plan|plan-with-core < text > binary" << endl;
+    cerr << "       " << program << " --to-text < binary > text" << endl;
+}
+
+/** Exit if `parser` has met malformed input */
+void check_input(const InputParser &parser)
+{
+    if (!parser.ok()) {
+        cerr << "The input is malformed." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void tasks_to_binary()
+{
+    InputParser parser(stdin);
+    const int algorithm = parser.read_int();
+
+    BinaryTraceWriter writer(stdout, BinaryTraceKind::TaskList, 5, algorithm);
+    int id, arrive_at, duration, priority, quantum;
+    while (parser.read_fields('/', {&id, &arrive_at, &duration, &priority, &quantum})) {
+        writer.write_row({id, arrive_at, duration, priority, quantum});
+    }
+    writer.finish();
+    check_input(parser);
+}
+
+void plan_to_binary(bool with_core)
+{
+    InputParser parser(stdin);
+
+    BinaryTraceWriter writer(stdout, BinaryTraceKind::RecordList, with_core ? 5 : 4);
+    int index, id, start_at, end_at, priority, core;
+    if (with_core) {
+        while (parser.read_fields('/', {&index, &id, &start_at, &end_at, &priority, &core})) {
+            writer.write_row({id, start_at, end_at, priority, core});
+        }
+    } else {
+        while (parser.read_fields('/', {&index, &id, &start_at, &end_at, &priority})) {
+            writer.write_row({id, start_at, end_at, priority});
+        }
+    }
+    writer.finish();
+    check_input(parser);
+}
+
+/** @return `false` if the input is not a binary trace, or is truncated */
+bool to_text()
+{
+    BinaryTraceReader reader(fileno(stdin));
+    if (!reader.ok()) {
+        return false;
+    }
+    const auto &header = reader.header();
+
+    if (header.kind == BinaryTraceKind::TaskList && header.n_fields == 5) {
+        printf("%d\n", header.algorithm);
+
+        int id, arrive_at, duration, priority, quantum;
+        while (reader.read_row({&id, &arrive_at, &duration, &priority, &quantum})) {
+            printf("%d/%d/%d/%d/%d\n", id, arrive_at, duration, priority, quantum);
+        }
+    } else if (header.kind == BinaryTraceKind::RecordList && header.n_fields == 4) {
+        int index = 1, id, start_at, end_at, priority;
+        while (reader.read_row({&id, &start_at, &end_at, &priority})) {
+            printf("%d/%d/%d/%d/%d\n", index, id, start_at, end_at, priority);
+            index++;
+        }
+    } else if (header.kind == BinaryTraceKind::RecordList && header.n_fields == 5) {
+        int index = 1, id, start_at, end_at, priority, core;
+        while (reader.read_row({&id, &start_at, &end_at, &priority, &core})) {
+            printf("%d/%d/%d/%d/%d/%d\n", index, id, start_at, end_at, priority, core);
+            index++;
+        }
+    } else {
+        return false;
+    }
+
+    return reader.ok();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "--to-binary=tasks") == 0) {
+        tasks_to_binary();
+    } else if (strcmp(argv[1], "--to-binary=plan") == 0) {
+        plan_to_binary(false);
+    } else if (strcmp(argv[1], "--to-binary=plan-with-core") == 0) {
+        plan_to_binary(true);
+    } else if (strcmp(argv[1], "--to-text") == 0) {
+        if (!to_text()) {
+            cerr << "The input is not a binary trace of a known kind, or is truncated." << endl;
+            return EXIT_FAILURE;
+        }
+    } else {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
@@ -1,573 +1,475 @@
-#include <assert.h>
-#include <iostream>
-#include <list>
-#include <signal.h>
+#include <atomic>
+#include <stdlib.h>
 #include <string.h>
+#include <thread>
 #include <vector>
 
-using namespace std;
-
-/** 调度算法 */
-enum Algorithm {
-    /** 先来先服务 */
-    FirstComeFirstService = 1,
-    /** 短作业优先 */
-    ShortestJobFirst = 2,
-    /** 最短剩余时间优先 */
-    ShortestRemainingTimeFirst = 3,
-    /** 时间片轮转 */
-    RoundRobin = 4,
-    /** 动态优先级 */
-    DynamicPriority = 5,
-};
-
-/** 任务 */
-struct Task {
-    /** 进程号 */
-    int id;
-    /** 到达时刻 */
-    int arrive_at;
-    /** 运行时间 */
-    int duration;
-    /** 优先级 */
-    int priority;
-    /** 时间片 */
-    int quantum;
-
-    bool operator==(const Task &other)
-    {
-        return this->id == other.id;
-    }
-    bool operator!=(const Task &other)
-    {
-        return !this->operator==(other);
-    }
-};
+#include "scheduler.hpp"
 
-/** 运行了中的任务 */
-struct TaskRuntime {
-    /** 进程号 */
-    int id;
-    /** 剩余运行时间 */
-    int duration_left;
-    /** 优先级 */
-    int priority;
-    /** 时间片 */
-    int quantum;
-
-    TaskRuntime(const Task &task)
-        : id(task.id), duration_left(task.duration), priority(task.priority), quantum(task.quantum) {}
-
-    bool operator==(const TaskRuntime &other)
-    {
-        return this->id == other.id;
-    }
-    bool operator!=(const TaskRuntime &other)
-    {
-        return !this->operator==(other);
-    }
-};
+using namespace std;
 
-/** 单条执行记录 */
-struct Record {
-    /** 进程号 */
-    int id;
-    /** 开始运行时刻 */
-    int start_at;
-    /** 结束运行时刻 */
-    int end_at;
-    /** 优先级 */
-    int priority;
-
-    Record(int id, int start_at, int end_at, int priority)
-        : id(id), start_at(start_at), end_at(end_at), priority(priority) {}
+/** 命令行选项 */
+struct Options {
+    EventQueueKind event_queue = EventQueueKind::BinaryHeap;
+    /** Read tasks and print records on the fly. The input must be sorted by arrival. */
+    bool stream = false;
+    /** the number of cores, 0 for the uniprocessor scheduler (without the core column) */
+    int n_cores = 0;
+    MultiprocessorMode smp = MultiprocessorMode::PerCoreQueues;
+
+    /** Run every combination below and print a summary for each, instead of the plan */
+    bool sweep = false;
+    /** empty for the algorithm in the input */
+    vector<Algorithm> algorithms;
+    /** `NOT_APPLICABLE` for the quanta in the input */
+    vector<int> quanta = {NOT_APPLICABLE};
+    vector<int> priority_offsets = {0};
+    /** the number of threads for sweeping, 0 for all cores */
+    int n_jobs = 0;
+
+    AlgorithmConfig algorithm_config;
+
+    /** Where to write metrics as JSON lines, `NULL` for nowhere */
+    const char *metrics = NULL;
+
+    /** Read tasks in the binary format, see `binary_trace.hpp` */
+    bool binary_input = false;
+    /** Write the plan in the binary format */
+    bool binary_output = false;
+
+    /** Where to keep the state of `IncrementalScheduler` between runs, `NULL` for not incremental */
+    const char *incremental = NULL;
+    /** the minimum time between snapshots, see `IncrementalScheduler` */
+    int snapshot_interval = 100;
+
+    /** Where to write `engine_stats` at exit, `NULL` for nowhere. Needs `SCHEDULER_STATS`. */
+    const char *engine_stats = NULL;
+    /** Write `engine_stats` in the Prometheus text format instead of JSON */
+    bool engine_stats_prometheus = false;
 };
 
-typedef vector<Record> Plan;
-
-/** 输入 */
-struct Input {
-    Algorithm algorithm;
-    /** 任务列表，按到达时间升序排列，同时到达时先输入的在前 */
-    list<Task> tasks;
-};
+void print_usage(const char *program)
+{
+    cerr << "Usage: " << program << " [--event-queue=heap|calendar] [--stream] [--cores=N] [--smp=per-core|global] [--metrics=PATH] [--input-format=text|binary] [--output-format=text|binary] [--engine-stats=PATH] [--engine-stats-format=json|prometheus] [--mlfq-quanta=Q,…] [--mlfq-boost=T] [--cfs-latency=T] [--cfs-min-slice=T] [--incremental=PATH [--snapshot-interval=T]] < input" << endl;
+    cerr << "       " << program << " --sweep [--algorithms=A,…] [--quanta=Q,…] [--priority-offsets=P,…] [--jobs=N] < input" << endl;
+}
 
-Input read_input()
+/**
+ * @brief Parse comma-separated integers like `1,2,-3`
+ *
+ * @return `false` if malformed
+ */
+bool parse_int_list(const char *str, vector<int> &values)
 {
-    Input input;
+    values.clear();
 
-    int algo_index;
-    cin >> algo_index;
-    input.algorithm = (Algorithm)algo_index;
-
-    int last_id = -1;
-    Task task;
-    while (EOF != scanf("%d/%d/%d/%d/%d",
-                        &task.id, &task.arrive_at, &task.duration,
-                        &task.priority, &task.quantum)) {
-        assert(last_id < task.id);
-
-        // Find the first task after last arrival
-        // or the first task arrives in the meantime but has lower priority.
-        auto t = input.tasks.begin();
-        const auto end = input.tasks.end();
-        while (t != end &&
-               (t->arrive_at < task.arrive_at ||
-                (t->arrive_at == task.arrive_at && t->priority <= task.priority))) {
-            t++;
+    while (true) {
+        char *end;
+        const long v = strtol(str, &end, 10);
+        if (end == str) {
+            return false;
         }
+        values.push_back((int)v);
 
-        // Insert
-        input.tasks.insert(t, Task(task));
+        if (*end == '\0') {
+            return true;
+        } else if (*end != ',') {
+            return false;
+        }
+        str = end + 1;
     }
-
-    return input;
 }
 
-void print_plan(const Plan &schedule)
+/** If `arg` is `option` followed by a value, return the value, otherwise `NULL` */
+const char *option_value(const char *arg, const char *option)
 {
-    int index = 1;
-    for (const auto &record : schedule) {
-        printf("%d/%d/%d/%d/%d\n",
-               index,
-               record.id, record.start_at, record.end_at, record.priority);
-        index++;
-    }
+    const auto n = strlen(option);
+    return strncmp(arg, option, n) == 0 ? arg + n : NULL;
 }
 
-void assert_sorted(const list<Task> &tasks)
+Options parse_args(int argc, char *argv[])
 {
-    int last_arrive_at = -1;
-    for (auto &&t : tasks) {
-        assert(t.arrive_at >= last_arrive_at);
-        last_arrive_at = t.arrive_at;
+    Options options;
+    /** whether any option that only makes sense with `--sweep` is given */
+    bool sweep_only = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--event-queue=heap") == 0) {
+            options.event_queue = EventQueueKind::BinaryHeap;
+        } else if (strcmp(argv[i], "--event-queue=calendar") == 0) {
+            options.event_queue = EventQueueKind::Calendar;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            options.stream = true;
+        } else if (strncmp(argv[i], "--cores=", strlen("--cores=")) == 0) {
+            options.n_cores = atoi(argv[i] + strlen("--cores="));
+            if (options.n_cores <= 0) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--smp=per-core") == 0) {
+            options.smp = MultiprocessorMode::PerCoreQueues;
+        } else if (strcmp(argv[i], "--smp=global") == 0) {
+            options.smp = MultiprocessorMode::GlobalQueue;
+        } else if (strcmp(argv[i], "--sweep") == 0) {
+            options.sweep = true;
+        } else if (const auto value = option_value(argv[i], "--algorithms=")) {
+            sweep_only = true;
+            vector<int> algorithms;
+            if (!parse_int_list(value, algorithms)) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            for (auto &&a : algorithms) {
+                if (a < Algorithm::FirstComeFirstService || a > Algorithm::CompletelyFair) {
+                    print_usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                options.algorithms.push_back((Algorithm)a);
+            }
+        } else if (const auto value = option_value(argv[i], "--quanta=")) {
+            sweep_only = true;
+            // Non-positive quanta would never finish a task, and `-1` would collide with `NOT_APPLICABLE`.
+            bool ok = parse_int_list(value, options.quanta);
+            for (auto &&q : options.quanta) {
+                ok = ok && q > 0;
+            }
+            if (!ok) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (const auto value = option_value(argv[i], "--priority-offsets=")) {
+            sweep_only = true;
+            if (!parse_int_list(value, options.priority_offsets)) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (const auto value = option_value(argv[i], "--jobs=")) {
+            sweep_only = true;
+            options.n_jobs = atoi(value);
+            if (options.n_jobs <= 0) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (const auto value = option_value(argv[i], "--mlfq-quanta=")) {
+            bool ok = parse_int_list(value, options.algorithm_config.mlfq.quanta) &&
+                      options.algorithm_config.mlfq.quanta.size() <= MultilevelQueue::MAX_LEVELS;
+            for (auto &&q : options.algorithm_config.mlfq.quanta) {
+                ok = ok && q > 0;
+            }
+            if (!ok) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (const auto value = option_value(argv[i], "--mlfq-boost=")) {
+            options.algorithm_config.mlfq.boost_interval = atoi(value);
+            if (options.algorithm_config.mlfq.boost_interval < 0) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (const auto value = option_value(argv[i], "--cfs-latency=")) {
+            options.algorithm_config.cfs.latency = atoi(value);
+            if (options.algorithm_config.cfs.latency <= 0) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (const auto value = option_value(argv[i], "--cfs-min-slice=")) {
+            options.algorithm_config.cfs.min_slice = atoi(value);
+            if (options.algorithm_config.cfs.min_slice <= 0) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (const auto value = option_value(argv[i], "--incremental=")) {
+            options.incremental = value;
+        } else if (const auto value = option_value(argv[i], "--snapshot-interval=")) {
+            options.snapshot_interval = atoi(value);
+            if (options.snapshot_interval <= 0) {
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (const auto value = option_value(argv[i], "--metrics=")) {
+            options.metrics = value;
+        } else if (strcmp(argv[i], "--input-format=text") == 0) {
+            options.binary_input = false;
+        } else if (strcmp(argv[i], "--input-format=binary") == 0) {
+            options.binary_input = true;
+        } else if (strcmp(argv[i], "--output-format=text") == 0) {
+            options.binary_output = false;
+        } else if (strcmp(argv[i], "--output-format=binary") == 0) {
+            options.binary_output = true;
+        } else if (const auto value = option_value(argv[i], "--engine-stats=")) {
+#ifdef SCHEDULER_STATS
+            options.engine_stats = value;
+#else
+            cerr << "Rebuild with `-DSCHEDULER_STATS` to use `--engine-stats`." << endl;
+            exit(EXIT_FAILURE);
+#endif
+        } else if (strcmp(argv[i], "--engine-stats-format=json") == 0) {
+            options.engine_stats_prometheus = false;
+        } else if (strcmp(argv[i], "--engine-stats-format=prometheus") == 0) {
+            options.engine_stats_prometheus = true;
+        } else {
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
     }
-}
-
-void not_implemented()
-{
-    cerr << "Not implemented." << endl;
-    raise(SIGFPE);
-}
-
-enum EventType {
-    /** [*] → ready */
-    Arrive,
-    /** running → ready */
-    Interrupt,
-    /** running → [*] */
-    Complete,
 
-    PrivateUse,
-};
-
-#define NOT_APPLICABLE -1
+    if (options.sweep && (options.stream || options.n_cores > 0 || options.metrics != NULL || options.engine_stats != NULL)) {
+        // A sweep needs all tasks loaded, runs on a uniprocessor, and prints its own summary.
+        // Besides, its threads have their own `engine_stats`.
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (options.incremental != NULL && (options.sweep || options.stream || options.n_cores > 0 || options.metrics != NULL)) {
+        // Incremental runs need all tasks loaded, run on a uniprocessor, and only keep the plan.
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (!options.sweep && sweep_only) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
 
-struct Event {
-    EventType type;
-    int at;
-    /** Only for arrive events, `NOT_APPLICABLE` otherwise */
-    int task_id;
+    return options;
+}
 
-    Event(EventType type, int at, int task_id) : type(type), at(at), task_id(task_id) {}
+/** One combination in a sweep */
+struct SweepConfig {
+    Algorithm algorithm;
+    TaskOverrides overrides;
 };
 
-using TaskRuntimeIterator = list<TaskRuntime>::iterator;
-
-class Scheduler
+/** Run `config` on `tasks` and tally into `metrics` */
+void run_sweep_config(const vector<Task> &tasks, EventQueueKind queue_kind, const AlgorithmConfig &algorithm_config, const SweepConfig &config, Metrics &metrics)
 {
-protected:
-    const list<Task> &tasks;
-
-    /** ready and running tasks (default: ascending sort by `arrive_at`) */
-    list<TaskRuntime> working_tasks;
-
-    /** the running task in `working tasks`, `end` if nothing is running */
-    TaskRuntimeIterator running_task;
-
-    /** events in the future (always ascending sorted) */
-    list<Event> events;
-
-public:
-    Scheduler(const list<Task> &tasks) : tasks(tasks)
-    {
-        this->working_tasks = list<TaskRuntime>();
-        this->running_task = this->working_tasks.end();
-
-        this->events = list<Event>();
-    }
-
-    Plan run()
-    {
-        Plan plan = Plan();
-        register_arrivals();
+    ArrivalsFromTasks arrivals(tasks);
+    unique_ptr<Scheduler> scheduler(make_scheduler(config.algorithm, arrivals, queue_kind, algorithm_config));
+    scheduler->override_tasks(config.overrides);
 
-        while (!this->events.empty()) {
-            auto event = this->events.front();
-            this->events.pop_front();
-
-            handle_event(event, plan);
-        }
-
-        return plan;
-    }
-
-protected:
-    /**
-     * Get the task in `tasks` by id and convert to `TaskRuntime`
-     */
-    TaskRuntime get_task(int id)
-    {
-        auto task = this->tasks.begin();
-
-        const auto end = this->tasks.end();
-        while (task != end && task->id != id) {
-            task++;
-        }
-        assert(task != end);
-        return TaskRuntime(*task);
-    }
+    PlanDiscarder discarder;
+    PlanSinkMetrics plan(discarder, metrics);
+    scheduler->run(plan);
+}
 
-    virtual void register_event(Event event)
-    {
-        auto e = this->events.begin();
-        const auto end = this->events.end();
-        while (e != end && e->at <= event.at) {
-            e++;
+/**
+ * @brief Run every combination of algorithms, quanta and priority offsets, and print one row for each
+ *
+ * `tasks` are shared by all threads, read-only.
+ * Rows are printed in the order of combinations, regardless of which finishes first.
+ */
+void run_sweep(const Input &input, const Options &options)
+{
+    vector<SweepConfig> configs;
+    const auto &algorithms = options.algorithms.empty() ? vector<Algorithm>{input.algorithm} : options.algorithms;
+    for (auto &&a : algorithms) {
+        for (auto &&q : options.quanta) {
+            for (auto &&p : options.priority_offsets) {
+                SweepConfig config;
+                config.algorithm = a;
+                config.overrides.quantum = q;
+                config.overrides.priority_offset = p;
+                configs.push_back(config);
+            }
         }
-
-        this->events.insert(e, event);
     }
 
-    /**
-     * @brief Register tasks' arrivals
-     *
-     * Default implementation: Push tasks by the same order as `this->tasks`.
-     */
-    virtual void register_arrivals()
-    {
-        for (auto &&t : this->tasks) {
-            // We push back here in favor of using O(n) `register event`.
-            this->events.push_back(Event(
-                EventType::Arrive,
-                t.arrive_at,
-                t.id));
+    vector<Metrics> summaries(configs.size());
+    atomic<size_t> next(0);
+    const auto work = [&]() {
+        for (size_t i; (i = next++) < configs.size();) {
+            run_sweep_config(input.tasks, options.event_queue, options.algorithm_config, configs[i], summaries[i]);
         }
     };
 
-    bool nothing_running()
-    {
-        return this->running_task == this->working_tasks.end();
+    size_t n_jobs = options.n_jobs > 0 ? options.n_jobs : max(1u, thread::hardware_concurrency());
+    n_jobs = min(n_jobs, configs.size());
+    vector<thread> workers;
+    for (size_t j = 1; j < n_jobs; j++) {
+        workers.emplace_back(work);
     }
-
-    virtual void handle_event(Event event, Plan &plan)
-    {
-        switch (event.type) {
-        case EventType::Arrive:
-            this->on_arrive(event, plan);
-            break;
-        case EventType::Complete:
-            this->on_complete(event, plan);
-            break;
-        case EventType::Interrupt:
-            this->on_interrupt(event, plan);
-            break;
-        }
+    work();
+    for (auto &&w : workers) {
+        w.join();
     }
 
-    virtual void on_arrive(Event event, Plan &plan)
-    {
-        auto task = this->get_task(event.task_id);
-        this->working_tasks.push_back(task);
+    printf("algorithm,quantum,priority_offset,records,makespan,utilisation,mean_turnaround,mean_waiting,"
+           "mean_response,p95_turnaround,context_switches\n");
+    for (size_t i = 0; i < configs.size(); i++) {
+        const auto &c = configs[i];
+        const auto &s = summaries[i];
 
-        if (this->nothing_running()) {
-            this->on_interrupt(event, plan);
+        printf("%d,", c.algorithm);
+        if (c.overrides.quantum == NOT_APPLICABLE) {
+            printf("-,");
+        } else {
+            printf("%d,", c.overrides.quantum);
         }
+        printf("%d,%lld,%d,%.4f,%.2f,%.2f,%.2f,%d,%lld\n",
+               c.overrides.priority_offset,
+               s.n_records, s.makespan, s.utilisation(),
+               s.turnaround.mean(), s.waiting.mean(), s.response.mean(),
+               s.turnaround.percentile(0.95), s.n_context_switches);
     }
+}
 
-    virtual void on_complete(Event event, Plan &plan)
-    {
-        this->working_tasks.erase(this->running_task);
-        this->running_task = this->working_tasks.end();
-
-        this->on_interrupt(event, plan);
-    }
-
-    virtual void on_interrupt(Event event, Plan &plan)
-    {
-        if (this->working_tasks.empty()) {
-            this->running_task = this->working_tasks.end();
-            return;
-        }
-
-        auto task = this->working_tasks.begin();
-        this->running_task = task;
-        auto end_at = event.at + task->duration_left;
-        plan.push_back(Record(task->id, event.at, end_at, task->priority));
-
-        this->register_event(Event(EventType::Complete, end_at, NOT_APPLICABLE));
-    };
-};
-
-class SchedulerFCFS : public Scheduler
-{
-public:
-    SchedulerFCFS(const list<Task> &tasks) : Scheduler(tasks) {}
-};
-
-class SchedulerSJF : public Scheduler
+/**
+ * @brief Schedule `input`, resuming from the state kept in `options.incremental`, and update it
+ *
+ * If the state is missing, saved with other options, or `input` does not extend its trace, `input` is scheduled from scratch.
+ * The state is written to a temporary file first, so an interrupted run leaves the old one intact.
+ */
+void run_incremental(const Input &input, const Options &options, BinaryTraceWriter *binary_output)
 {
-public:
-    SchedulerSJF(const list<Task> &tasks) : Scheduler(tasks) {}
-
-protected:
-    void on_arrive(Event event, Plan &plan)
-    {
-        auto task = this->get_task(event.task_id);
-
-        // We sort `working_tasks` by `duration_left`
-        auto where = this->working_tasks.begin();
-        const auto end = this->working_tasks.end();
-        while (where != end && where->duration_left <= task.duration_left) {
-            ++where;
-        }
+    IncrementalScheduler scheduler(input.algorithm, options.event_queue, options.algorithm_config, options.snapshot_interval);
 
-        this->working_tasks.insert(where, task);
-
-        if (this->nothing_running()) {
-            this->on_interrupt(event, plan);
-        }
+    FILE *state = fopen(options.incremental, "rb");
+    bool resumed = false;
+    if (state != NULL) {
+        resumed = scheduler.load(state) && scheduler.extend(input.tasks);
+        fclose(state);
+    }
+    if (!resumed) {
+        scheduler.clear();
+        scheduler.extend(input.tasks);
     }
-};
-
-class SchedulerPreemptive : public Scheduler
-{
-public:
-    SchedulerPreemptive(const list<Task> &tasks) : Scheduler(tasks) {}
-
-protected:
-    virtual void on_interrupt(Event event, Plan &plan)
-    {
-        this->handle_last_running_task();
-
-        if (this->working_tasks.empty()) {
-            return;
-        }
-        this->running_task = this->next_task_to_run();
-
-        const auto duration = this->can_run_for(event.at);
-        this->running_task->duration_left -= duration;
 
-        auto end_at = event.at + duration;
-        this->record_running_task(plan, event.at, end_at);
+    print_plan(scheduler.run(), false, binary_output);
 
-        if (this->running_task->duration_left > 0) {
-            this->register_event(Event(EventType::Interrupt, end_at, NOT_APPLICABLE));
-        } else {
-            this->register_event(Event(EventType::Complete, end_at, NOT_APPLICABLE));
-        }
+    const string temporary = string(options.incremental) + ".tmp";
+    state = fopen(temporary.c_str(), "wb");
+    if (state == NULL) {
+        perror(temporary.c_str());
+        exit(EXIT_FAILURE);
     }
-
-    virtual void handle_last_running_task()
-    {
-        this->running_task = this->working_tasks.end();
+    scheduler.save(state);
+    const bool written = !ferror(state);
+    if (fclose(state) != 0 || !written || rename(temporary.c_str(), options.incremental) != 0) {
+        perror(options.incremental);
+        exit(EXIT_FAILURE);
     }
+}
 
-    virtual void record_running_task(Plan &plan, int start_at, int end_at)
-    {
-        plan.push_back(Record(this->running_task->id, start_at, end_at, this->running_task->priority));
+#ifdef SCHEDULER_STATS
+void write_engine_stats(const char *path, bool prometheus)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        exit(EXIT_FAILURE);
     }
 
-    virtual TaskRuntimeIterator next_task_to_run()
-    {
-        return this->working_tasks.begin();
-    };
-
-    /** how long can the `running_task` run for from `now` */
-    virtual int can_run_for(int now)
-    {
-        return this->running_task->duration_left;
+    if (prometheus) {
+        engine_stats.print_prometheus(file);
+    } else {
+        engine_stats.print_json(file);
     }
-};
+    fclose(file);
+}
+#endif
 
-class SchedulerShortestRemainingTimeFirst : public SchedulerPreemptive
+/** Exit if the input read so far is malformed or truncated */
+void check_input(const InputParser &parser, const BinaryTraceReader *binary_input)
 {
-public:
-    SchedulerShortestRemainingTimeFirst(const list<Task> &tasks) : SchedulerPreemptive(tasks) {}
-
-protected:
-    TaskRuntimeIterator next_task_to_run()
-    {
-        auto task = this->working_tasks.begin();
-
-        const auto end = this->working_tasks.end();
-        for (auto t = this->working_tasks.begin(); t != end; ++t) {
-            if (t->duration_left < task->duration_left) {
-                task = t;
-            }
-        }
-
-        return task;
+    if (!parser.ok() || (binary_input != NULL && !binary_input->ok())) {
+        cerr << "The input is malformed or truncated." << endl;
+        exit(EXIT_FAILURE);
     }
+}
 
-    int can_run_for(int now)
-    {
-        auto next_arrival = this->events.begin();
-        const auto end = this->events.end();
-        while (next_arrival != end && next_arrival->type != EventType::Arrive) {
-            ++next_arrival;
-        }
+int main(int argc, char *argv[])
+{
+    const auto options = parse_args(argc, argv);
+    InputParser parser(stdin);
 
-        if (next_arrival == end) {
-            // if nothing will arrive
-            return this->running_task->duration_left;
-        } else {
-            return min(this->running_task->duration_left, next_arrival->at - now);
+    Algorithm algorithm;
+    unique_ptr<BinaryTraceReader> binary_input;
+    unique_ptr<TaskReader> reader;
+    if (options.binary_input) {
+        binary_input.reset(new BinaryTraceReader(fileno(stdin)));
+        const auto &header = binary_input->header();
+        if (!binary_input->ok() || header.kind != BinaryTraceKind::TaskList || header.n_fields != 5) {
+            cerr << "The input is not a binary task list." << endl;
+            exit(EXIT_FAILURE);
         }
+        algorithm = (Algorithm)header.algorithm;
+        reader.reset(new TaskReaderBinary(*binary_input));
+    } else {
+        algorithm = (Algorithm)parser.read_int();
+        reader.reset(new TaskReaderText(parser));
     }
 
-    void record_running_task(Plan &plan, int start_at, int end_at)
-    {
-        if (!plan.empty() && this->running_task->id == plan.back().id) {
-            plan.back().end_at = end_at;
-        } else {
-            SchedulerPreemptive::record_running_task(plan, start_at, end_at);
-        }
+    Input input;
+    unique_ptr<Arrivals> arrivals;
+    if (options.stream) {
+        input.algorithm = algorithm;
+        arrivals.reset(new ArrivalsFromStream(*reader));
+    } else {
+        input = read_input(algorithm, *reader);
+        check_input(parser, binary_input.get());
+        assert_sorted(input.tasks);
+        arrivals.reset(new ArrivalsFromTasks(input.tasks));
     }
-};
 
-class SchedulerRoundRobin : public SchedulerPreemptive
-{
-public:
-    SchedulerRoundRobin(const list<Task> &tasks) : SchedulerPreemptive(tasks) {}
+    if (options.sweep) {
+        run_sweep(input, options);
+        return 0;
+    }
 
-protected:
-    int can_run_for(int now)
-    {
-        return min(this->running_task->duration_left, this->running_task->quantum);
+    const bool with_core = options.n_cores > 0;
+    unique_ptr<BinaryTraceWriter> binary_output;
+    if (options.binary_output) {
+        binary_output.reset(new BinaryTraceWriter(stdout, BinaryTraceKind::RecordList, with_core ? 5 : 4, input.algorithm));
     }
 
-    void handle_last_running_task()
-    {
-        if (this->running_task != this->working_tasks.end()) {
-            // Move last `running_task` to the end
-            this->working_tasks.splice(this->working_tasks.end(), this->working_tasks, this->running_task);
+    if (options.incremental != NULL) {
+        run_incremental(input, options, binary_output.get());
+        if (binary_output) {
+            binary_output->finish();
         }
-
-        this->running_task = this->working_tasks.end();
+        return 0;
     }
-};
 
-/**
- * @note
- *
- * Timeline:
- *
- * 1. A task starts running.
- * 2. Some tasks arrive. (Their priorities -= 1)
- * 3. The running task is interrupted.
- * 4. Some other tasks arrives in the meantime. (Their priorites don't change)
- * 5. We decide what to run next.
- *
- * Ideally, We update priorities between 3 and 4.
- *
- * But it's impossible: arrive events are handled before the interrupt event.
- * In other words, 4 will happen before 3. Therefore, we introduce a new event to
- * increase priorities.
- */
-class SchedulerDynamicPriority : public SchedulerPreemptive
-{
-public:
-    SchedulerDynamicPriority(const list<Task> &tasks) : SchedulerPreemptive(tasks) {}
-
-protected:
-    TaskRuntimeIterator next_task_to_run()
-    {
-        auto task = this->working_tasks.begin();
-
-        const auto end = this->working_tasks.end();
-        for (auto t = this->working_tasks.begin(); t != end; ++t) {
-            if (t->priority < task->priority) {
-                task = t;
-            }
-        }
+    PlanCompactor collector;
+    PlanPrinter printer(with_core, binary_output.get());
+    PlanSink &output = options.stream ? (PlanSink &)printer : (PlanSink &)collector;
 
-        return task;
+    FILE *metrics_file = NULL;
+    if (options.metrics != NULL) {
+        metrics_file = fopen(options.metrics, "w");
+        if (metrics_file == NULL) {
+            perror(options.metrics);
+            exit(EXIT_FAILURE);
+        }
     }
-
-    int can_run_for(int now)
-    {
-        return min(this->running_task->duration_left, this->running_task->quantum);
+    Metrics metrics(max(options.n_cores, 1), metrics_file);
+    PlanSinkMetrics with_metrics(output, metrics);
+    PlanSink &plan = metrics_file != NULL ? (PlanSink &)with_metrics : output;
+
+    if (options.n_cores > 0) {
+        MultiprocessorScheduler scheduler(input.algorithm, *arrivals, options.event_queue, options.n_cores, options.smp, options.algorithm_config);
+        scheduler.run(plan);
+    } else {
+        unique_ptr<Scheduler> scheduler(make_scheduler(input.algorithm, *arrivals, options.event_queue, options.algorithm_config));
+        scheduler->run(plan);
     }
 
-    /** Decrease the `running_task`'s priority then record it */
-    void record_running_task(Plan &plan, int start_at, int end_at)
-    {
-        this->running_task->priority += 3;
-
-        SchedulerPreemptive::record_running_task(plan, start_at, end_at);
+    if (!options.stream) {
+        print_plan(collector.plan, with_core, binary_output.get());
     }
-
-    void register_event(Event event)
-    {
-        if (event.type == EventType::Complete || event.type == EventType::Interrupt) {
-            auto e = this->events.begin();
-            const auto end = this->events.end();
-            while (e != end && e->at < event.at) {
-                e++;
-            }
-
-            this->events.insert(e, Event(EventType::PrivateUse, event.at, NOT_APPLICABLE));
-        }
-
-        SchedulerPreemptive::register_event(event);
+    if (binary_output) {
+        binary_output->finish();
     }
-
-    void handle_event(Event event, Plan &plan)
-    {
-        if (event.type == EventType::PrivateUse) {
-            // Increase ready tasks' priorites
-            for (auto &&t : this->working_tasks) {
-                if (t != *this->running_task) {
-                    t.priority = max(t.priority - 1, 0);
-                }
-            }
-        } else {
-            SchedulerPreemptive::handle_event(event, plan);
-        }
+    if (options.stream) {
+        check_input(parser, binary_input.get());
     }
-};
-
-int main()
-{
-    const auto input = read_input();
-    assert_sorted(input.tasks);
-
-    Scheduler *scheduler = NULL;
-    switch (input.algorithm) {
-    case Algorithm::FirstComeFirstService:
-        scheduler = new SchedulerFCFS(input.tasks);
-        break;
-    case Algorithm::ShortestJobFirst:
-        scheduler = new SchedulerSJF(input.tasks);
-        break;
-    case Algorithm::ShortestRemainingTimeFirst:
-        scheduler = new SchedulerShortestRemainingTimeFirst(input.tasks);
-        break;
-    case Algorithm::RoundRobin:
-        scheduler = new SchedulerRoundRobin(input.tasks);
-        break;
-    case Algorithm::DynamicPriority:
-        scheduler = new SchedulerDynamicPriority(input.tasks);
-        break;
-
-    default:
-        not_implemented();
-        break;
+    if (metrics_file != NULL) {
+        metrics.print_summary(metrics_file);
+        fclose(metrics_file);
     }
-
-    print_plan(scheduler->run());
-    delete scheduler;
+#ifdef SCHEDULER_STATS
+    if (options.engine_stats != NULL) {
+        write_engine_stats(options.engine_stats, options.engine_stats_prometheus);
+    }
+#endif
 
     return 0;
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 #include <list>
@@ -5,6 +6,10 @@
 #include <string.h>
 #include <vector>
 
+#include "aging_queue.hpp"
+#include "indexed_heap.hpp"
+#include "input_parser.hpp"
+
 using namespace std;
 
 /** 调度算法 */
@@ -40,7 +45,7 @@ struct Task {
     }
 };
 
-/** 运行了一半的任务，只有可抢占算法会用到。 */
+/** 运行了一半的任务 */
 struct TaskRuntime {
     /** 进程号 */
     int id;
@@ -50,9 +55,11 @@ struct TaskRuntime {
     int priority;
     /** 时间片 */
     int quantum;
+    /** 进入就绪队列的顺序，由`ReadyQueue`设置 */
+    int order;
 
     TaskRuntime(const Task &task)
-        : id(task.id), duration_left(task.duration), priority(task.priority), quantum(task.quantum) {}
+        : id(task.id), duration_left(task.duration), priority(task.priority), quantum(task.quantum), order(0) {}
 
     bool operator==(const TaskRuntime &other)
     {
@@ -81,37 +88,66 @@ struct ScheduleRecord {
 
 typedef vector<ScheduleRecord> Schedule;
 
+/** Order tasks by `Key`, then by when they entered the ready queue */
+template <int TaskRuntime::*Key>
+struct TaskRuntimeLess {
+    bool operator()(const TaskRuntime &a, const TaskRuntime &b) const
+    {
+        if (a.*Key != b.*Key) {
+            return a.*Key < b.*Key;
+        }
+        return a.order < b.order;
+    }
+};
+
+/**
+ * @brief Ready tasks, the one with the smallest `Key` first
+ *
+ * Tasks with the same `Key` are first in, first out, as if they were in a `list` sorted by `Key`.
+ */
+template <int TaskRuntime::*Key>
+class ReadyQueue : public IndexedHeap<TaskRuntime, TaskRuntimeLess<Key>>
+{
+protected:
+    int n_pushed = 0;
+
+public:
+    typename ReadyQueue::Handle push_back(TaskRuntime task)
+    {
+        task.order = this->n_pushed;
+        this->n_pushed++;
+        return this->push(task);
+    }
+};
+
 /** 输入 */
 struct Input {
     Algorithm algorithm;
     /** 任务列表，按到达时间升序排列，同时到达时先输入的在前 */
-    list<Task> tasks;
+    vector<Task> tasks;
 };
 
 Input read_input()
 {
     Input input;
+    InputParser parser(stdin);
 
-    int algo_index;
-    cin >> algo_index;
-    input.algorithm = (Algorithm)algo_index;
+    input.algorithm = (Algorithm)parser.read_int();
 
     int last_id = -1;
     Task task;
-    while (EOF != scanf("%d/%d/%d/%d/%d",
-                        &task.id, &task.arrive_at, &task.duration,
-                        &task.priority, &task.quantum)) {
+    while (parser.read_fields('/', {&task.id, &task.arrive_at, &task.duration,
+                                    &task.priority, &task.quantum})) {
         assert(last_id < task.id);
+        input.tasks.push_back(task);
+    }
 
-        // Find the first task after last arrival.
-        auto t = input.tasks.begin();
-        const auto end = input.tasks.end();
-        while (t != end && t->arrive_at <= task.arrive_at) {
-            t++;
-        }
-
-        // Insert
-        input.tasks.insert(t, Task(task));
+    // Sort by arrival stably.
+    const auto arrives_earlier = [](const Task &a, const Task &b) {
+        return a.arrive_at < b.arrive_at;
+    };
+    if (!is_sorted(input.tasks.begin(), input.tasks.end(), arrives_earlier)) {
+        stable_sort(input.tasks.begin(), input.tasks.end(), arrives_earlier);
     }
 
     return input;
@@ -128,7 +164,7 @@ void print_schedule(const Schedule &schedule)
     }
 }
 
-void assert_sorted(const list<Task> &tasks)
+void assert_sorted(const vector<Task> &tasks)
 {
     int last_arrive_at = -1;
     for (auto &&t : tasks) {
@@ -143,7 +179,7 @@ void not_implemented()
     raise(SIGFPE);
 }
 
-Schedule first_come_first_service(const list<Task> &tasks)
+Schedule first_come_first_service(const vector<Task> &tasks)
 {
     Schedule schedule;
 
@@ -166,38 +202,32 @@ Schedule first_come_first_service(const list<Task> &tasks)
     return schedule;
 }
 
-Schedule shortest_job_first(const list<Task> &tasks)
+Schedule shortest_job_first(const vector<Task> &tasks)
 {
     Schedule schedule;
 
     int clock = 0;
     auto first_future_task = tasks.begin();
     // arrived but not done tasks
-    list<Task> ready_tasks;
+    ReadyQueue<&TaskRuntime::duration_left> ready_tasks;
 
     while (first_future_task != tasks.end() || !ready_tasks.empty()) {
         // 1. Update `ready_tasks` and `first_future_task`
         while (first_future_task != tasks.end() && first_future_task->arrive_at <= clock) {
-            ready_tasks.push_back(*first_future_task);
+            ready_tasks.push_back(TaskRuntime(*first_future_task));
             first_future_task++;
         }
 
-        // 2. Find the shortest task in `ready_tasks`
-        auto shortest_task = ready_tasks.front();
-        for (auto &&t : ready_tasks) {
-            if (shortest_task.duration > t.duration) {
-                shortest_task = t;
-            }
-        }
-        ready_tasks.remove(shortest_task);
+        // 2. Take the shortest task from `ready_tasks`
+        auto shortest_task = ready_tasks.pop();
 
         // 3. Run it
         schedule.push_back(ScheduleRecord(
             shortest_task.id,
             clock,
-            clock + shortest_task.duration,
+            clock + shortest_task.duration_left,
             shortest_task.priority));
-        clock += shortest_task.duration;
+        clock += shortest_task.duration_left;
     }
 
     return schedule;
@@ -207,12 +237,13 @@ Schedule shortest_job_first(const list<Task> &tasks)
  * @brief Move arrived tasks to `ready_tasks`
  * If nothing arrives, the clock will be advanced to next arrival, then try again.
  *
- * @param ready_tasks 保证执行后时不空，除非`first_future_task == end`
+ * @param ready_tasks 保证执行后时不空，除非`first_future_task == end`。可以是`list<TaskRuntime>`或`ReadyQueue`。
  * @param first_future_task (can be changed)
  * @param end `first_future_task`所在队列的结尾
  * @param clock (can be changed)
  */
-void handle_tasks_arrival(list<TaskRuntime> &ready_tasks, list<Task>::const_iterator &first_future_task, const list<Task>::const_iterator &end, int &clock)
+template <typename ReadyTasks>
+void handle_tasks_arrival(ReadyTasks &ready_tasks, vector<Task>::const_iterator &first_future_task, const vector<Task>::const_iterator &end, int &clock)
 {
     while (first_future_task != end && first_future_task->arrive_at <= clock) {
         ready_tasks.push_back(TaskRuntime(*first_future_task));
@@ -226,27 +257,21 @@ void handle_tasks_arrival(list<TaskRuntime> &ready_tasks, list<Task>::const_iter
     }
 }
 
-Schedule shortest_remaining_time_first(const list<Task> &tasks)
+Schedule shortest_remaining_time_first(const vector<Task> &tasks)
 {
     Schedule schedule;
 
     int clock = 0;
     auto first_future_task = tasks.begin();
     // arrived but not done tasks
-    list<TaskRuntime> ready_tasks;
+    ReadyQueue<&TaskRuntime::duration_left> ready_tasks;
 
     while (first_future_task != tasks.end() || !ready_tasks.empty()) {
         // 1. Update `ready_tasks` and `first_future_task`
         handle_tasks_arrival(ready_tasks, first_future_task, tasks.end(), clock);
 
-        // 2. Find the shortest task in `ready_tasks`
-        auto shortest_task = ready_tasks.front();
-        for (auto &&t : ready_tasks) {
-            if (shortest_task.duration_left > t.duration_left) {
-                shortest_task = t;
-            }
-        }
-        ready_tasks.remove(shortest_task);
+        // 2. Take the shortest task from `ready_tasks`
+        auto shortest_task = ready_tasks.pop();
 
         // 3. Run it
         // 3.1 Calculate how long it will run.
@@ -278,7 +303,7 @@ Schedule shortest_remaining_time_first(const list<Task> &tasks)
     return schedule;
 }
 
-Schedule round_robin(const list<Task> &tasks)
+Schedule round_robin(const vector<Task> &tasks)
 {
     Schedule schedule;
 
@@ -319,24 +344,35 @@ Schedule round_robin(const list<Task> &tasks)
     return schedule;
 }
 
-Schedule dynamic_priority(const list<Task> &tasks)
+struct TaskRuntimeEnteredEarlier {
+    bool operator()(const TaskRuntime &a, const TaskRuntime &b) const
+    {
+        return a.order < b.order;
+    }
+};
+
+Schedule dynamic_priority(const vector<Task> &tasks)
 {
     Schedule schedule;
 
     int clock = 0;
     auto first_future_task = tasks.begin();
-    // arrived but not done tasks, always sorted by arrival
-    list<TaskRuntime> ready_tasks;
+    // arrived but not done tasks, except the running one
+    // Their `priority` fields are kept by `ready_tasks`, and out of date.
+    AgingQueue<TaskRuntime, TaskRuntimeEnteredEarlier> ready_tasks;
+    int n_arrived = 0;
 
     const auto end = tasks.end();
     while (first_future_task != end || !ready_tasks.empty()) {
         // 1. Update `ready_tasks` and `first_future_task`
         while (first_future_task != end && first_future_task->arrive_at <= clock) {
             auto new_task = TaskRuntime(*first_future_task);
+            new_task.order = n_arrived;
+            n_arrived++;
             if (first_future_task->arrive_at < clock) {
                 new_task.priority = max(new_task.priority - 1, 0);
             }
-            ready_tasks.push_back(new_task);
+            ready_tasks.push(new_task, new_task.priority);
             first_future_task++;
         }
         // If nothing arrives and nothing ready, skip to next arrival and try again.
@@ -345,39 +381,31 @@ Schedule dynamic_priority(const list<Task> &tasks)
             continue;
         }
 
-        // 2. Get next task from `ready_tasks`
-        auto next_task = ready_tasks.begin();
-        const auto ready_tasks_end = ready_tasks.end();
-        for (auto t = ready_tasks.begin(); t != ready_tasks_end; ++t) {
-            if (t->priority < next_task->priority) {
-                next_task = t;
-            }
-        }
-        // We won't remove it until it's done this time.
+        // 2. Take next task from `ready_tasks`
+        // It keeps its `order`, so it will be put back to where it was.
+        int priority;
+        auto next_task = ready_tasks.pop(priority);
+        next_task.priority = priority;
 
         // 4. Run it
         // 4.0 Update tasks' priorities
-        next_task->priority += 3;
-        for (auto &&t : ready_tasks) {
-            if (t != *next_task) {
-                t.priority = max(t.priority - 1, 0);
-            }
-        }
+        next_task.priority += 3;
+        ready_tasks.age();
         // 4.1 Calculate how long it will run.
-        int duration = min(next_task->duration_left, next_task->quantum);
+        int duration = min(next_task.duration_left, next_task.quantum);
         // 4.2 Update the schedule
         schedule.push_back(ScheduleRecord(
-            next_task->id,
+            next_task.id,
             clock,
             clock + duration,
-            next_task->priority));
+            next_task.priority));
         // 4.3 Let time fly.
-        next_task->duration_left -= duration;
+        next_task.duration_left -= duration;
         clock += duration;
 
-        // 5. Remove it if it completes.
-        if (next_task->duration_left == 0) {
-            ready_tasks.erase(next_task);
+        // 5. Put it back unless it completes.
+        if (next_task.duration_left > 0) {
+            ready_tasks.push(next_task, next_task.priority);
         }
     }
 
@@ -0,0 +1,232 @@
+/**
+ * @file
+ * @brief Generate synthetic inputs for ex_1, reproducibly from a seed
+ *
+ * Arrivals:
+ *
+ * - `poisson`: exponential gaps with mean 1 / rate
+ * - `bursty`: batches of tasks arrive at once, the batch size is geometric with mean `burst`,
+ *   and gaps between batches are exponential with mean burst / rate, so the average rate is the same
+ *
+ * Durations:
+ *
+ * - `pareto`: heavy-tailed, `min` × U^(−1/alpha), capped at `max`
+ * - `uniform`: uniform in [min, max]
+ *
+ * Priorities and quanta are uniform in the given ranges.
+ */
+
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binary_trace.hpp"
+
+using namespace std;
+
+/** 命令行选项 */
+struct Options {
+    long long n = 1000;
+    unsigned long long seed = 0;
+    int algorithm = 1;
+
+    bool bursty = false;
+    /** tasks per unit of time */
+    double rate = 0.25;
+    /** the mean batch size, if `bursty` */
+    double burst = 8;
+
+    bool pareto = true;
+    double alpha = 1.5;
+    int min_duration = 1;
+    int max_duration = 100000;
+
+    int min_priority = 0;
+    int max_priority = 10;
+    int min_quantum = 1;
+    int max_quantum = 5;
+
+    bool binary = false;
+};
+
+void print_usage(const char *program)
+{
+    cerr << "Usage: " << program << " [--n=N] [--seed=S] [--algorithm=A]" << endl
+         << "       [--arrivals=poisson|bursty] [--rate=R] [--burst=B]" << endl
+         << "       [--durations=pareto|uniform] [--alpha=ALPHA] [--duration=MIN-MAX]" << endl
+         << "       [--priority=MIN-MAX] [--quantum=MIN-MAX] [--format=text|binary] > input" << endl;
+}
+
+/** If `arg` is `option` followed by a value, return the value, otherwise `NULL` */
+const char *option_value(const char *arg, const char *option)
+{
+    const auto n = strlen(option);
+    return strncmp(arg, option, n) == 0 ? arg + n : NULL;
+}
+
+/** Parse `MIN-MAX`, where both are non-negative */
+bool parse_range(const char *str, int &min, int &max)
+{
+    return sscanf(str, "%d-%d", &min, &max) == 2 && 0 <= min && min <= max;
+}
+
+Options parse_args(int argc, char *argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        bool ok = true;
+
+        if (const auto value = option_value(argv[i], "--n=")) {
+            options.n = atoll(value);
+            ok = options.n >= 0;
+        } else if (const auto value = option_value(argv[i], "--seed=")) {
+            options.seed = strtoull(value, NULL, 10);
+        } else if (const auto value = option_value(argv[i], "--algorithm=")) {
+            options.algorithm = atoi(value);
+            ok = 1 <= options.algorithm && options.algorithm <= 7;
+        } else if (strcmp(argv[i], "--arrivals=poisson") == 0) {
+            options.bursty = false;
+        } else if (strcmp(argv[i], "--arrivals=bursty") == 0) {
+            options.bursty = true;
+        } else if (const auto value = option_value(argv[i], "--rate=")) {
+            options.rate = atof(value);
+            ok = options.rate > 0;
+        } else if (const auto value = option_value(argv[i], "--burst=")) {
+            options.burst = atof(value);
+            ok = options.burst >= 1;
+        } else if (strcmp(argv[i], "--durations=pareto") == 0) {
+            options.pareto = true;
+        } else if (strcmp(argv[i], "--durations=uniform") == 0) {
+            options.pareto = false;
+        } else if (const auto value = option_value(argv[i], "--alpha=")) {
+            options.alpha = atof(value);
+            ok = options.alpha > 0;
+        } else if (const auto value = option_value(argv[i], "--duration=")) {
+            ok = parse_range(value, options.min_duration, options.max_duration) && options.min_duration > 0;
+        } else if (const auto value = option_value(argv[i], "--priority=")) {
+            ok = parse_range(value, options.min_priority, options.max_priority);
+        } else if (const auto value = option_value(argv[i], "--quantum=")) {
+            ok = parse_range(value, options.min_quantum, options.max_quantum) && options.min_quantum > 0;
+        } else if (strcmp(argv[i], "--format=text") == 0) {
+            options.binary = false;
+        } else if (strcmp(argv[i], "--format=binary") == 0) {
+            options.binary = true;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return options;
+}
+
+/**
+ * @brief Draw tasks one by one
+ *
+ * Distributions are computed here from `mt19937_64`, rather than by `<random>`'s distributions,
+ * whose results differ between standard libraries.
+ */
+class Generator
+{
+protected:
+    const Options &options;
+    mt19937_64 random;
+
+    /** the current time, as a real number */
+    double now;
+    /** the number of tasks left in the current batch */
+    long long batch_left;
+
+public:
+    Generator(const Options &options) : options(options), random(options.seed), now(0), batch_left(0) {}
+
+    /** Draw the next task */
+    void next(int &arrive_at, int &duration, int &priority, int &quantum)
+    {
+        this->advance();
+        arrive_at = (int)this->now;
+
+        if (this->options.pareto) {
+            const double d = this->options.min_duration * pow(this->open_uniform(), -1 / this->options.alpha);
+            duration = (int)min(d, (double)this->options.max_duration);
+        } else {
+            duration = this->integer(this->options.min_duration, this->options.max_duration);
+        }
+
+        priority = this->integer(this->options.min_priority, this->options.max_priority);
+        quantum = this->integer(this->options.min_quantum, this->options.max_quantum);
+    }
+
+protected:
+    /** Move `now` to the next arrival */
+    void advance()
+    {
+        if (!this->options.bursty) {
+            this->now += this->exponential(1 / this->options.rate);
+            return;
+        }
+
+        if (this->batch_left == 0) {
+            this->now += this->exponential(this->options.burst / this->options.rate);
+            // Geometric on {1, 2, …} with mean `burst`
+            const double p = 1 / this->options.burst;
+            this->batch_left = p >= 1 ? 1 : 1 + (long long)floor(log(this->open_uniform()) / log(1 - p));
+        }
+        this->batch_left--;
+    }
+
+    /** uniform in (0, 1] */
+    double open_uniform()
+    {
+        return (double)((this->random() >> 11) + 1) / (double)(1ULL << 53);
+    }
+
+    double exponential(double mean)
+    {
+        return -mean * log(this->open_uniform());
+    }
+
+    /** uniform in [min, max] */
+    int integer(int min, int max)
+    {
+        return min + (int)(this->random() % (unsigned long long)(max - min + 1));
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    const auto options = parse_args(argc, argv);
+    Generator generator(options);
+
+    unique_ptr<BinaryTraceWriter> binary;
+    if (options.binary) {
+        binary.reset(new BinaryTraceWriter(stdout, BinaryTraceKind::TaskList, 5, options.algorithm));
+    } else {
+        printf("%d\n", options.algorithm);
+    }
+
+    int arrive_at, duration, priority, quantum;
+    for (long long id = 1; id <= options.n; id++) {
+        generator.next(arrive_at, duration, priority, quantum);
+
+        if (binary) {
+            binary->write_row({(int)id, arrive_at, duration, priority, quantum});
+        } else {
+            printf("%lld/%d/%d/%d/%d\n", id, arrive_at, duration, priority, quantum);
+        }
+    }
+
+    if (binary) {
+        binary->finish();
+    }
+
+    return 0;
+}
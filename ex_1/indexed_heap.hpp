@@ -0,0 +1,203 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Addressable d-ary min-heap
+ *
+ * `push` returns a handle, which stays valid until the item is popped or erased.
+ * With the handle, the item can be read, modified (then `update`d) or erased in O(log n).
+ *
+ * `Less` should be a strict total order, otherwise ties are broken arbitrarily.
+ */
+template <typename T, typename Less, size_t D = 4>
+class IndexedHeap
+{
+public:
+    using Handle = size_t;
+
+protected:
+    static constexpr size_t NONE = (size_t)-1;
+
+    /** items by handle */
+    std::vector<T> items;
+    /** where each handle is in `heap`, `NONE` if the handle is free */
+    std::vector<size_t> position;
+    /** handles that can be reused */
+    std::vector<Handle> free_handles;
+    /** handles, arranged as a heap */
+    std::vector<Handle> heap;
+
+    Less less;
+
+public:
+    IndexedHeap(Less less = Less()) : less(less) {}
+
+    /** Copy `other`, but order by `less`, which must agree with `other`'s order on its items */
+    IndexedHeap(const IndexedHeap &other, Less less)
+        : items(other.items), position(other.position), free_handles(other.free_handles), heap(other.heap), less(less) {}
+
+    bool empty() const
+    {
+        return this->heap.empty();
+    }
+
+    size_t size() const
+    {
+        return this->heap.size();
+    }
+
+    Handle push(const T &item)
+    {
+        Handle handle;
+        if (this->free_handles.empty()) {
+            handle = this->items.size();
+            this->items.push_back(item);
+            this->position.push_back(NONE);
+        } else {
+            handle = this->free_handles.back();
+            this->free_handles.pop_back();
+            this->items[handle] = item;
+        }
+
+        this->position[handle] = this->heap.size();
+        this->heap.push_back(handle);
+        this->sift_up(this->heap.size() - 1);
+
+        return handle;
+    }
+
+    Handle top_handle() const
+    {
+        assert(!this->empty());
+        return this->heap.front();
+    }
+
+    const T &top() const
+    {
+        return this->items[this->top_handle()];
+    }
+
+    T pop()
+    {
+        const auto handle = this->top_handle();
+        const T item = this->items[handle];
+        this->erase(handle);
+        return item;
+    }
+
+    /** Remember to `update` after modifying the key. */
+    T &operator[](Handle handle)
+    {
+        assert(this->contains(handle));
+        return this->items[handle];
+    }
+
+    const T &operator[](Handle handle) const
+    {
+        assert(this->contains(handle));
+        return this->items[handle];
+    }
+
+    bool contains(Handle handle) const
+    {
+        return handle < this->position.size() && this->position[handle] != NONE;
+    }
+
+    /** Restore the order after the item's key changed (either way) */
+    void update(Handle handle)
+    {
+        assert(this->contains(handle));
+        const auto pos = this->position[handle];
+        this->sift_up(pos);
+        this->sift_down(this->position[handle]);
+    }
+
+    void erase(Handle handle)
+    {
+        assert(this->contains(handle));
+        const auto pos = this->position[handle];
+        const auto last = this->heap.size() - 1;
+
+        if (pos != last) {
+            this->swap_at(pos, last);
+        }
+        this->heap.pop_back();
+        this->position[handle] = NONE;
+        this->free_handles.push_back(handle);
+
+        if (pos != last) {
+            const auto moved = this->heap[pos];
+            this->sift_up(pos);
+            this->sift_down(this->position[moved]);
+        }
+    }
+
+    /** Apply `f` to every item, then rebuild the heap in O(n) */
+    template <typename F>
+    void update_all(F f)
+    {
+        for (auto &&h : this->heap) {
+            f(this->items[h]);
+        }
+
+        if (this->heap.size() > 1) {
+            for (size_t pos = (this->heap.size() - 2) / D + 1; pos-- > 0;) {
+                this->sift_down(pos);
+            }
+        }
+    }
+
+protected:
+    bool less_at(size_t a, size_t b) const
+    {
+        return this->less(this->items[this->heap[a]], this->items[this->heap[b]]);
+    }
+
+    void swap_at(size_t a, size_t b)
+    {
+        std::swap(this->heap[a], this->heap[b]);
+        this->position[this->heap[a]] = a;
+        this->position[this->heap[b]] = b;
+    }
+
+    void sift_up(size_t pos)
+    {
+        while (pos > 0) {
+            const auto parent = (pos - 1) / D;
+            if (!this->less_at(pos, parent)) {
+                break;
+            }
+            this->swap_at(pos, parent);
+            pos = parent;
+        }
+    }
+
+    void sift_down(size_t pos)
+    {
+        const auto n = this->heap.size();
+        while (true) {
+            const auto first_child = D * pos + 1;
+            if (first_child >= n) {
+                break;
+            }
+
+            auto best = first_child;
+            const auto end = first_child + D < n ? first_child + D : n;
+            for (auto c = first_child + 1; c < end; c++) {
+                if (this->less_at(c, best)) {
+                    best = c;
+                }
+            }
+
+            if (!this->less_at(best, pos)) {
+                break;
+            }
+            this->swap_at(pos, best);
+            pos = best;
+        }
+    }
+};
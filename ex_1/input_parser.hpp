@@ -0,0 +1,129 @@
+#pragma once
+
+#include <ctype.h>
+#include <initializer_list>
+#include <stdio.h>
+#include <vector>
+
+/**
+ * @brief Reads integers from a `FILE`, chunk by chunk
+ *
+ * A hand-rolled replacement of `scanf("%d/%d/…")`, which is slow for large inputs.
+ * Like `scanf`, it stops at malformed input, and `ok()` tells whether that has happened.
+ */
+class InputParser
+{
+protected:
+    FILE *file;
+    std::vector<char> buffer;
+    /** the next char in `buffer` */
+    size_t pos;
+    /** the number of valid chars in `buffer` */
+    size_t len;
+    /** whether everything read so far is well-formed */
+    bool valid;
+
+public:
+    InputParser(FILE *file, size_t buffer_size = 1 << 16)
+        : file(file), buffer(buffer_size), pos(0), len(0), valid(true) {}
+
+    /** Whether everything read so far is well-formed */
+    bool ok() const
+    {
+        return this->valid;
+    }
+
+    /** Whether nothing but spaces is left */
+    bool at_end()
+    {
+        this->skip_spaces();
+        return this->peek() == EOF;
+    }
+
+    /**
+     * @brief Read an integer like `%d`, leading spaces skipped
+     *
+     * @return 0 if there is no integer, in which case `ok()` becomes `false`
+     */
+    int read_int()
+    {
+        this->skip_spaces();
+
+        bool negative = false;
+        if (this->peek() == '-' || this->peek() == '+') {
+            negative = this->get() == '-';
+        }
+
+        if (!isdigit(this->peek())) {
+            this->valid = false;
+            return 0;
+        }
+        int value = 0;
+        while (isdigit(this->peek())) {
+            value = value * 10 + (this->get() - '0');
+        }
+
+        return negative ? -value : value;
+    }
+
+    /**
+     * @brief Read integers separated by `separator`, like `scanf("%d/%d/…")`
+     *
+     * @return `false` if nothing is left, or if the input is malformed, in which case `ok()` becomes `false` as well
+     */
+    bool read_fields(char separator, std::initializer_list<int *> fields)
+    {
+        if (!this->valid || this->at_end()) {
+            return false;
+        }
+
+        bool is_first = true;
+        for (auto &&f : fields) {
+            if (is_first) {
+                is_first = false;
+            } else if (this->get() != separator) {
+                this->valid = false;
+                return false;
+            }
+
+            *f = this->read_int();
+            if (!this->valid) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+protected:
+    int peek()
+    {
+        if (this->pos == this->len && !this->refill()) {
+            return EOF;
+        }
+        return (unsigned char)this->buffer[this->pos];
+    }
+
+    int get()
+    {
+        const auto c = this->peek();
+        if (c != EOF) {
+            this->pos++;
+        }
+        return c;
+    }
+
+    void skip_spaces()
+    {
+        while (isspace(this->peek())) {
+            this->pos++;
+        }
+    }
+
+    bool refill()
+    {
+        this->pos = 0;
+        this->len = fread(this->buffer.data(), 1, this->buffer.size(), this->file);
+        return this->len > 0;
+    }
+};
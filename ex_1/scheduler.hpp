@@ -0,0 +1,3532 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Event-driven schedulers, shared by `ex_1-event.cpp` and `scheduler_api.cpp`
+ */
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <limits.h>
+#include <list>
+#include <map>
+#include <math.h>
+#include <memory>
+#include <queue>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#include "aging_queue.hpp"
+#include "binary_trace.hpp"
+#include "indexed_heap.hpp"
+#include "input_parser.hpp"
+#include "varint.hpp"
+
+using namespace std;
+
+#define NOT_APPLICABLE -1
+
+/** 调度算法 */
+enum Algorithm {
+    /** 先来先服务 */
+    FirstComeFirstService = 1,
+    /** 短作业优先 */
+    ShortestJobFirst = 2,
+    /** 最短剩余时间优先 */
+    ShortestRemainingTimeFirst = 3,
+    /** 时间片轮转 */
+    RoundRobin = 4,
+    /** 动态优先级 */
+    DynamicPriority = 5,
+    /** 多级反馈队列 */
+    MultilevelFeedbackQueue = 6,
+    /** 完全公平调度 */
+    CompletelyFair = 7,
+};
+
+/** 多级反馈队列的参数 */
+struct MlfqConfig {
+    /** 各级的时间片，级数即其长度，不超过 64 */
+    vector<int> quanta = {2, 4, 8};
+    /** 每隔多久把所有任务提升到最高级，0 表示从不 */
+    int boost_interval = 100;
+};
+
+/** 完全公平调度的参数 */
+struct CfsConfig {
+    /** 调度周期：每个就绪的任务在这段时间内都应运行一次，时间片按权重分配 */
+    int latency = 12;
+    /** 最短的时间片 */
+    int min_slice = 1;
+};
+
+/** 各调度算法的参数 */
+struct AlgorithmConfig {
+    MlfqConfig mlfq;
+    CfsConfig cfs;
+};
+
+/** 任务 */
+struct Task {
+    /** 进程号 */
+    int id;
+    /** 到达时刻 */
+    int arrive_at;
+    /** 运行时间 */
+    int duration;
+    /** 优先级 */
+    int priority;
+    /** 时间片 */
+    int quantum;
+
+    bool operator==(const Task &other)
+    {
+        return this->id == other.id;
+    }
+    bool operator!=(const Task &other)
+    {
+        return !this->operator==(other);
+    }
+};
+
+/** 运行了中的任务 */
+struct TaskRuntime {
+    /** 进程号 */
+    int id;
+    /** 剩余运行时间 */
+    int duration_left;
+    /** 优先级 */
+    int priority;
+    /** 时间片 */
+    int quantum;
+    /** 到达顺序，从 0 开始 */
+    int arrival;
+    /** 上次运行所在的核，`NOT_APPLICABLE`表示还未运行过 */
+    int core;
+    /** 加权的虚拟运行时间，仅用于完全公平调度，`NOT_APPLICABLE`表示还未进入就绪队列 */
+    long long vruntime;
+
+    TaskRuntime(const Task &task, int arrival)
+        : id(task.id), duration_left(task.duration), priority(task.priority), quantum(task.quantum), arrival(arrival),
+          core(NOT_APPLICABLE), vruntime(NOT_APPLICABLE) {}
+
+    void save(VarintWriter &out) const
+    {
+        for (long long v : {this->id, this->duration_left, this->priority, this->quantum, this->arrival, this->core}) {
+            out.write(v);
+        }
+        out.write(this->vruntime);
+    }
+
+    /** Read what `save` writes. Check `in.ok()` afterwards. */
+    static TaskRuntime load(VarintReader &in)
+    {
+        Task task;
+        task.id = in.read();
+        task.arrive_at = 0;
+        task.duration = in.read();
+        task.priority = in.read();
+        task.quantum = in.read();
+
+        TaskRuntime runtime(task, in.read());
+        runtime.core = in.read();
+        runtime.vruntime = in.read();
+        return runtime;
+    }
+
+    bool operator==(const TaskRuntime &other)
+    {
+        return this->id == other.id;
+    }
+    bool operator!=(const TaskRuntime &other)
+    {
+        return !this->operator==(other);
+    }
+};
+
+/** 参数扫描时对任务的修改 */
+struct TaskOverrides {
+    /** 时间片，`NOT_APPLICABLE`表示不修改 */
+    int quantum = NOT_APPLICABLE;
+    /** 优先级的增量，结果不小于 0；为 0 时不修改（负优先级也保留） */
+    int priority_offset = 0;
+
+    void apply(TaskRuntime &task) const
+    {
+        if (this->quantum != NOT_APPLICABLE) {
+            task.quantum = this->quantum;
+        }
+        if (this->priority_offset != 0) {
+            task.priority = max(0, task.priority + this->priority_offset);
+        }
+    }
+};
+
+/** 单条执行记录 */
+struct Record {
+    /** 进程号 */
+    int id;
+    /** 开始运行时刻 */
+    int start_at;
+    /** 结束运行时刻 */
+    int end_at;
+    /** 优先级 */
+    int priority;
+    /** 运行所在的核，单处理机时总是 0 */
+    int core;
+
+    Record(int id, int start_at, int end_at, int priority, int core = 0)
+        : id(id), start_at(start_at), end_at(end_at), priority(priority), core(core) {}
+};
+
+typedef vector<Record> Plan;
+
+/**
+ * @brief Records encoded compactly, for long plans kept in memory
+ *
+ * Each record is a few varints, relative to the previous record:
+ * - `end_at - start_at`, shifted left to hold the `Flag`s in the low bits;
+ * - `start_at` as a zigzag delta from the previous `end_at`, omitted if contiguous;
+ * - `id` as a zigzag delta;
+ * - `priority` as a zigzag delta, omitted if unchanged;
+ * - `core`, omitted if unchanged.
+ *
+ * A typical record takes 2–4 bytes instead of `sizeof(Record)`.
+ * Consecutive slices of the same task are already merged by the schedulers (see `record_running_task`),
+ * so the encoding itself is lossless.
+ *
+ * Records can be iterated in order, or accessed by index through a sparse index of every `BLOCK_SIZE`-th record.
+ */
+class CompactPlan
+{
+public:
+    /** the number of records between entries of the sparse index */
+    static constexpr size_t BLOCK_SIZE = 64;
+
+protected:
+    enum Flag : unsigned {
+        StartsAtLastEnd = 1,
+        SamePriority = 2,
+        SameCore = 4,
+    };
+    static constexpr int N_FLAGS = 3;
+
+    /** where a block starts, and the record before it */
+    struct Checkpoint {
+        size_t offset;
+        Record last;
+    };
+
+    vector<uint8_t> bytes;
+    /** the `i`-th checkpoint is before the `i * BLOCK_SIZE`-th record */
+    vector<Checkpoint> index;
+    /** the last record pushed */
+    Record last;
+    size_t n_records;
+
+public:
+    /** Decodes records one by one */
+    class const_iterator
+    {
+    protected:
+        const CompactPlan *plan;
+        size_t offset;
+        size_t i;
+        Record record;
+
+    public:
+        const_iterator(const CompactPlan *plan, size_t offset, size_t i, Record last)
+            : plan(plan), offset(offset), i(i), record(last)
+        {
+            this->decode();
+        }
+
+        const Record &operator*() const
+        {
+            return this->record;
+        }
+
+        const Record *operator->() const
+        {
+            return &this->record;
+        }
+
+        const_iterator &operator++()
+        {
+            this->i++;
+            this->decode();
+            return *this;
+        }
+
+        bool operator==(const const_iterator &other) const
+        {
+            return this->i == other.i;
+        }
+        bool operator!=(const const_iterator &other) const
+        {
+            return !this->operator==(other);
+        }
+
+    protected:
+        void decode()
+        {
+            if (this->i < this->plan->n_records) {
+                this->record = this->plan->decode(this->offset, this->record);
+            }
+        }
+    };
+
+    CompactPlan() : last(0, 0, 0, 0), n_records(0) {}
+
+    void push_back(const Record &record)
+    {
+        assert(record.end_at >= record.start_at);
+
+        if (this->n_records % BLOCK_SIZE == 0) {
+            this->index.push_back(Checkpoint{this->bytes.size(), this->last});
+        }
+
+        unsigned flags = 0;
+        if (record.start_at == this->last.end_at) {
+            flags |= Flag::StartsAtLastEnd;
+        }
+        if (record.priority == this->last.priority) {
+            flags |= Flag::SamePriority;
+        }
+        if (record.core == this->last.core) {
+            flags |= Flag::SameCore;
+        }
+
+        append_varint(this->bytes, (uint64_t)(record.end_at - record.start_at) << N_FLAGS | flags);
+        if (!(flags & Flag::StartsAtLastEnd)) {
+            append_varint(this->bytes, zigzag((long long)record.start_at - this->last.end_at));
+        }
+        append_varint(this->bytes, zigzag((long long)record.id - this->last.id));
+        if (!(flags & Flag::SamePriority)) {
+            append_varint(this->bytes, zigzag((long long)record.priority - this->last.priority));
+        }
+        if (!(flags & Flag::SameCore)) {
+            append_varint(this->bytes, record.core);
+        }
+
+        this->last = record;
+        this->n_records++;
+    }
+
+    size_t size() const
+    {
+        return this->n_records;
+    }
+
+    bool empty() const
+    {
+        return this->n_records == 0;
+    }
+
+    /** the `i`-th record, decoded from the nearest checkpoint */
+    Record operator[](size_t i) const
+    {
+        assert(i < this->n_records);
+
+        const auto &checkpoint = this->index[i / BLOCK_SIZE];
+        size_t offset = checkpoint.offset;
+        Record record = checkpoint.last;
+        for (size_t j = i / BLOCK_SIZE * BLOCK_SIZE; j <= i; j++) {
+            record = this->decode(offset, record);
+        }
+        return record;
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0, 0, Record(0, 0, 0, 0));
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, this->bytes.size(), this->n_records, this->last);
+    }
+
+    /** the bytes allocated */
+    size_t memory_usage() const
+    {
+        return this->bytes.capacity() * sizeof(uint8_t) + this->index.capacity() * sizeof(Checkpoint);
+    }
+
+    void shrink_to_fit()
+    {
+        this->bytes.shrink_to_fit();
+        this->index.shrink_to_fit();
+    }
+
+protected:
+    /** Decode the varint at `offset`, which `push_back` wrote whole */
+    uint64_t get_varint(size_t &offset) const
+    {
+        uint64_t value;
+        if (!decode_varint(this->bytes.data(), this->bytes.size(), offset, value)) {
+            assert(false);
+        }
+        return value;
+    }
+
+    /** Decode the record at `offset` following `last`, and move `offset` to the next one */
+    Record decode(size_t &offset, const Record &last) const
+    {
+        const auto head = this->get_varint(offset);
+        const unsigned flags = head & ((1 << N_FLAGS) - 1);
+
+        const int start_at = flags & Flag::StartsAtLastEnd ? last.end_at : last.end_at + unzigzag(this->get_varint(offset));
+        const int end_at = start_at + (head >> N_FLAGS);
+        const int id = last.id + unzigzag(this->get_varint(offset));
+        const int priority = flags & Flag::SamePriority ? last.priority : last.priority + unzigzag(this->get_varint(offset));
+        const int core = flags & Flag::SameCore ? last.core : this->get_varint(offset);
+
+        return Record(id, start_at, end_at, priority, core);
+    }
+};
+
+/** 输入 */
+struct Input {
+    Algorithm algorithm;
+    /** 任务列表，按到达时间升序排列，同时到达时先输入的在前 */
+    vector<Task> tasks;
+};
+
+/** Reads tasks one by one */
+class TaskReader
+{
+public:
+    virtual ~TaskReader() {}
+
+    /** @return `false` if nothing is left */
+    virtual bool read(Task &task) = 0;
+    /** the number of tasks in total if known, 0 otherwise */
+    virtual size_t size_hint() const
+    {
+        return 0;
+    }
+};
+
+/** Tasks in the text format, `id/arrive_at/duration/priority/quantum` per line */
+class TaskReaderText : public TaskReader
+{
+protected:
+    InputParser &parser;
+
+public:
+    /** The algorithm line should have been read from `parser`. */
+    TaskReaderText(InputParser &parser) : parser(parser) {}
+
+    bool read(Task &task)
+    {
+        return this->parser.read_fields('/', {&task.id, &task.arrive_at, &task.duration,
+                                              &task.priority, &task.quantum});
+    }
+};
+
+/** Tasks in the binary format, see `binary_trace.hpp` */
+class TaskReaderBinary : public TaskReader
+{
+protected:
+    BinaryTraceReader &reader;
+
+public:
+    /** `reader` should be a task list with 5 fields. */
+    TaskReaderBinary(BinaryTraceReader &reader) : reader(reader)
+    {
+        assert(reader.header().kind == BinaryTraceKind::TaskList && reader.header().n_fields == 5);
+    }
+
+    bool read(Task &task)
+    {
+        return this->reader.read_row({&task.id, &task.arrive_at, &task.duration,
+                                      &task.priority, &task.quantum});
+    }
+
+    size_t size_hint() const
+    {
+        const auto count = this->reader.header().count;
+        return count == BINARY_TRACE_UNKNOWN_COUNT ? 0 : count;
+    }
+};
+
+/** Sort by arrival, then by priority, stably */
+inline void sort_tasks(vector<Task> &tasks)
+{
+    const auto goes_before = [](const Task &a, const Task &b) {
+        return a.arrive_at < b.arrive_at ||
+               (a.arrive_at == b.arrive_at && a.priority < b.priority);
+    };
+    if (!is_sorted(tasks.begin(), tasks.end(), goes_before)) {
+        stable_sort(tasks.begin(), tasks.end(), goes_before);
+    }
+}
+
+/** Read all tasks and sort them. Ids need not be in order, as ties are broken by the input order. */
+inline Input read_input(Algorithm algorithm, TaskReader &reader)
+{
+    Input input;
+
+    input.algorithm = algorithm;
+    input.tasks.reserve(reader.size_hint());
+
+    Task task;
+    while (reader.read(task)) {
+        input.tasks.push_back(task);
+    }
+
+    sort_tasks(input.tasks);
+
+    return input;
+}
+
+/**
+ * @brief Print one record
+ *
+ * @param with_core whether to append the core column (for multiprocessor)
+ * @param binary if not `NULL`, write to it instead, without the index
+ */
+inline void print_record(int index, const Record &record, bool with_core, BinaryTraceWriter *binary = NULL)
+{
+    if (binary != NULL) {
+        if (with_core) {
+            binary->write_row({record.id, record.start_at, record.end_at, record.priority, record.core});
+        } else {
+            binary->write_row({record.id, record.start_at, record.end_at, record.priority});
+        }
+    } else if (with_core) {
+        printf("%d/%d/%d/%d/%d/%d\n",
+               index,
+               record.id, record.start_at, record.end_at, record.priority, record.core);
+    } else {
+        printf("%d/%d/%d/%d/%d\n",
+               index,
+               record.id, record.start_at, record.end_at, record.priority);
+    }
+}
+
+/** @tparam Records `Plan` or `CompactPlan` */
+template <typename Records>
+void print_plan(const Records &schedule, bool with_core = false, BinaryTraceWriter *binary = NULL)
+{
+    int index = 1;
+    for (const auto &record : schedule) {
+        print_record(index, record, with_core, binary);
+        index++;
+    }
+}
+
+inline void assert_sorted(const vector<Task> &tasks)
+{
+    int last_arrive_at = -1;
+    for (auto &&t : tasks) {
+        assert(t.arrive_at >= last_arrive_at);
+        last_arrive_at = t.arrive_at;
+    }
+}
+
+inline void not_implemented()
+{
+    cerr << "Not implemented." << endl;
+    raise(SIGFPE);
+}
+
+/** Tasks in the order of arrival */
+class Arrivals
+{
+public:
+    virtual ~Arrivals() {}
+
+    /** Whether all tasks have arrived */
+    virtual bool empty() = 0;
+    /** the next task to arrive */
+    virtual const Task &peek() = 0;
+    virtual void pop() = 0;
+};
+
+/** Arrivals from loaded `Input::tasks` */
+class ArrivalsFromTasks : public Arrivals
+{
+protected:
+    const vector<Task> &tasks;
+    /** an index rather than an iterator, so that it survives `tasks` growing */
+    size_t next;
+
+public:
+    ArrivalsFromTasks(const vector<Task> &tasks) : tasks(tasks), next(0) {}
+
+    bool empty()
+    {
+        return this->next == this->tasks.size();
+    }
+
+    const Task &peek()
+    {
+        return this->tasks[this->next];
+    }
+
+    void pop()
+    {
+        ++this->next;
+    }
+
+    /** Continue from the `i`-th task */
+    void seek(size_t i)
+    {
+        assert(i <= this->tasks.size());
+        this->next = i;
+    }
+};
+
+/**
+ * @brief Arrivals read from the input lazily
+ *
+ * Only tasks arriving at the same moment are buffered, and they are sorted by priority like `read_input`.
+ * Therefore the input must be sorted by arrival.
+ */
+class ArrivalsFromStream : public Arrivals
+{
+protected:
+    TaskReader &reader;
+    /** tasks arriving at the same moment, sorted */
+    deque<Task> group;
+    /** the first task of the next group, if `has_next_group` */
+    Task next_group;
+    bool has_next_group;
+
+public:
+    ArrivalsFromStream(TaskReader &reader) : reader(reader), has_next_group(false)
+    {
+        this->has_next_group = this->reader.read(this->next_group);
+    }
+
+    bool empty()
+    {
+        return this->group.empty() && !this->has_next_group;
+    }
+
+    const Task &peek()
+    {
+        if (this->group.empty()) {
+            this->read_group();
+        }
+        return this->group.front();
+    }
+
+    void pop()
+    {
+        this->peek();
+        this->group.pop_front();
+    }
+
+protected:
+    void read_group()
+    {
+        assert(this->has_next_group);
+        this->group.push_back(this->next_group);
+
+        Task task;
+        this->has_next_group = false;
+        while (this->reader.read(task)) {
+            if (task.arrive_at == this->group.front().arrive_at) {
+                this->group.push_back(task);
+            } else {
+                assert(task.arrive_at > this->group.front().arrive_at);
+                this->next_group = task;
+                this->has_next_group = true;
+                break;
+            }
+        }
+
+        stable_sort(this->group.begin(), this->group.end(), [](const Task &a, const Task &b) {
+            return a.priority < b.priority;
+        });
+    }
+};
+
+/** Where records go */
+class PlanSink
+{
+public:
+    virtual ~PlanSink() {}
+
+    /** Called when `task` arrives, before any of its records */
+    virtual void arrive(const Task &task) {}
+    virtual void push_back(Record record) = 0;
+    virtual bool empty() const = 0;
+    /** the last record, the only one that can still be changed */
+    virtual Record &back() = 0;
+    /** Called after the last record */
+    virtual void finish() {}
+};
+
+/** Collect records into a `Plan` */
+class PlanCollector : public PlanSink
+{
+public:
+    Plan plan;
+
+    void push_back(Record record)
+    {
+        this->plan.push_back(record);
+    }
+
+    bool empty() const
+    {
+        return this->plan.empty();
+    }
+
+    Record &back()
+    {
+        return this->plan.back();
+    }
+};
+
+/**
+ * @brief Collect records into a `CompactPlan`
+ *
+ * The last record is held back in case it changes, and encoded when the next one is pushed or at `finish`.
+ */
+class PlanCompactor : public PlanSink
+{
+public:
+    CompactPlan plan;
+
+protected:
+    /** the last record, not encoded yet if `pending` */
+    Record last;
+    bool pending;
+
+public:
+    PlanCompactor() : last(0, 0, 0, 0), pending(false) {}
+
+    void push_back(Record record)
+    {
+        this->flush();
+        this->last = record;
+        this->pending = true;
+    }
+
+    bool empty() const
+    {
+        return this->plan.empty() && !this->pending;
+    }
+
+    Record &back()
+    {
+        assert(this->pending);
+        return this->last;
+    }
+
+    void finish()
+    {
+        this->flush();
+        this->plan.shrink_to_fit();
+    }
+
+protected:
+    void flush()
+    {
+        if (this->pending) {
+            this->plan.push_back(this->last);
+            this->pending = false;
+        }
+    }
+};
+
+/** Print records like `print_plan`, as soon as they are final */
+class PlanPrinter : public PlanSink
+{
+protected:
+    /** the last record, held back in case it changes */
+    Record last;
+    /** the number of records pushed */
+    int n_records;
+    bool with_core;
+    /** see `print_record` */
+    BinaryTraceWriter *binary;
+
+public:
+    PlanPrinter(bool with_core = false, BinaryTraceWriter *binary = NULL)
+        : last(0, 0, 0, 0), n_records(0), with_core(with_core), binary(binary) {}
+
+    void push_back(Record record)
+    {
+        this->flush();
+        this->last = record;
+        this->n_records++;
+    }
+
+    bool empty() const
+    {
+        return this->n_records == 0;
+    }
+
+    Record &back()
+    {
+        assert(!this->empty());
+        return this->last;
+    }
+
+    void finish()
+    {
+        this->flush();
+        fflush(stdout);
+    }
+
+protected:
+    /** Print `last` */
+    void flush()
+    {
+        if (!this->empty()) {
+            print_record(this->n_records, this->last, this->with_core, this->binary);
+        }
+    }
+};
+
+/**
+ * @brief Forward records to another sink, and tally the time each core is busy
+ *
+ * A record is tallied once it is final, i.e. when the next one is pushed or at `finish`.
+ */
+class PlanSinkUsage : public PlanSink
+{
+public:
+    struct CoreUsage {
+        long long busy = 0;
+        long long n_slices = 0;
+    };
+
+    vector<CoreUsage> cores;
+    /** when the last record ends */
+    int makespan;
+
+protected:
+    PlanSink &sink;
+
+public:
+    PlanSinkUsage(PlanSink &sink, int n_cores) : cores(n_cores), makespan(0), sink(sink) {}
+
+    void arrive(const Task &task)
+    {
+        this->sink.arrive(task);
+    }
+
+    void push_back(Record record)
+    {
+        this->tally_back();
+        this->sink.push_back(record);
+    }
+
+    bool empty() const
+    {
+        return this->sink.empty();
+    }
+
+    Record &back()
+    {
+        return this->sink.back();
+    }
+
+    void finish()
+    {
+        this->tally_back();
+        this->sink.finish();
+    }
+
+protected:
+    void tally_back()
+    {
+        if (this->sink.empty()) {
+            return;
+        }
+
+        const auto &r = this->sink.back();
+        auto &usage = this->cores[r.core];
+        usage.busy += r.end_at - r.start_at;
+        usage.n_slices++;
+        this->makespan = max(this->makespan, r.end_at);
+    }
+};
+
+/** Keep only the last record, when only metrics are wanted */
+class PlanDiscarder : public PlanSink
+{
+protected:
+    Record last;
+    bool has_last;
+
+public:
+    PlanDiscarder() : last(0, 0, 0, 0), has_last(false) {}
+
+    void push_back(Record record)
+    {
+        this->last = record;
+        this->has_last = true;
+    }
+
+    bool empty() const
+    {
+        return !this->has_last;
+    }
+
+    Record &back()
+    {
+        assert(this->has_last);
+        return this->last;
+    }
+};
+
+/**
+ * @brief Counts of integer values, for exact percentiles
+ *
+ * Memory grows with the number of distinct values, not the number of values.
+ */
+class Distribution
+{
+protected:
+    map<int, long long> counts;
+    long long n;
+    long long sum;
+
+public:
+    Distribution() : n(0), sum(0) {}
+
+    void add(int value)
+    {
+        this->counts[value]++;
+        this->n++;
+        this->sum += value;
+    }
+
+    long long size() const
+    {
+        return this->n;
+    }
+
+    double mean() const
+    {
+        return this->n > 0 ? (double)this->sum / this->n : 0.0;
+    }
+
+    /**
+     * @brief The smallest value that at least `p` of the values are not greater than (nearest rank)
+     *
+     * @param p in (0, 1]
+     * @return 0 if empty
+     */
+    int percentile(double p) const
+    {
+        long long rank = (long long)ceil(p * this->n);
+        rank = max(rank, 1LL);
+
+        long long seen = 0;
+        for (auto &&c : this->counts) {
+            seen += c.second;
+            if (seen >= rank) {
+                return c.first;
+            }
+        }
+        return 0;
+    }
+
+    /** Print as a JSON object like `{"mean": …, "p50": …, "p95": …, "p99": …}` */
+    void print_json(FILE *file) const
+    {
+        fprintf(file, "{\"mean\": %.4f, \"p50\": %d, \"p95\": %d, \"p99\": %d}",
+                this->mean(), this->percentile(0.50), this->percentile(0.95), this->percentile(0.99));
+    }
+};
+
+/**
+ * @brief Scheduling metrics, computed as records become final
+ *
+ * Only tasks alive are kept. When a task completes, its metrics are added to the distributions,
+ * and printed to `task_output` as a JSON line if given.
+ *
+ * - turnaround: completed_at − arrive_at
+ * - waiting: turnaround − duration
+ * - response: (the first start) − arrive_at
+ * - context switch: a core starts a task other than the one it ran last
+ */
+class Metrics
+{
+public:
+    Distribution turnaround;
+    Distribution waiting;
+    Distribution response;
+
+    long long n_records;
+    long long n_context_switches;
+    /** the time cores are busy, summed over cores */
+    long long busy;
+    /** when the last record ends */
+    int makespan;
+
+protected:
+    struct LiveTask {
+        int arrive_at;
+        int duration;
+        int duration_left;
+        /** `NOT_APPLICABLE` if it has not run yet */
+        int first_run_at;
+    };
+
+    int n_cores;
+    /** per-task metrics go here, or nowhere if `NULL` */
+    FILE *task_output;
+    /** tasks that have arrived but not completed, by id */
+    unordered_map<int, LiveTask> live;
+    /** the task each core ran last, `NOT_APPLICABLE` if none */
+    vector<int> last_run;
+
+public:
+    Metrics(int n_cores = 1, FILE *task_output = NULL)
+        : n_records(0), n_context_switches(0), busy(0), makespan(0),
+          n_cores(n_cores), task_output(task_output), last_run(n_cores, NOT_APPLICABLE) {}
+
+    void arrive(const Task &task)
+    {
+        this->live[task.id] = LiveTask{task.arrive_at, task.duration, task.duration, NOT_APPLICABLE};
+    }
+
+    /** Tally a final record */
+    void tally(const Record &r)
+    {
+        this->n_records++;
+        this->busy += r.end_at - r.start_at;
+        this->makespan = max(this->makespan, r.end_at);
+
+        if (this->last_run[r.core] != NOT_APPLICABLE && this->last_run[r.core] != r.id) {
+            this->n_context_switches++;
+        }
+        this->last_run[r.core] = r.id;
+
+        auto found = this->live.find(r.id);
+        assert(found != this->live.end());
+        auto &t = found->second;
+        if (t.first_run_at == NOT_APPLICABLE) {
+            t.first_run_at = r.start_at;
+        }
+        t.duration_left -= r.end_at - r.start_at;
+
+        if (t.duration_left <= 0) {
+            this->complete(r.id, t, r.end_at);
+            this->live.erase(found);
+        }
+    }
+
+    long long n_completed() const
+    {
+        return this->turnaround.size();
+    }
+
+    /** the time cores are idle before `makespan`, summed over cores */
+    long long idle() const
+    {
+        return (long long)this->n_cores * this->makespan - this->busy;
+    }
+
+    double utilisation() const
+    {
+        return this->makespan > 0 ? (double)this->busy / ((long long)this->n_cores * this->makespan) : 0.0;
+    }
+
+    /** tasks completed per unit of time */
+    double throughput() const
+    {
+        return this->makespan > 0 ? (double)this->n_completed() / this->makespan : 0.0;
+    }
+
+    /** Print the summary as a JSON line */
+    void print_summary(FILE *file) const
+    {
+        fprintf(file, "{\"type\": \"summary\", \"tasks\": %lld, \"records\": %lld, \"cores\": %d, "
+                      "\"makespan\": %d, \"busy\": %lld, \"idle\": %lld, \"utilisation\": %.4f, "
+                      "\"throughput\": %.6f, \"context_switches\": %lld",
+                this->n_completed(), this->n_records, this->n_cores,
+                this->makespan, this->busy, this->idle(), this->utilisation(),
+                this->throughput(), this->n_context_switches);
+
+        fprintf(file, ", \"turnaround\": ");
+        this->turnaround.print_json(file);
+        fprintf(file, ", \"waiting\": ");
+        this->waiting.print_json(file);
+        fprintf(file, ", \"response\": ");
+        this->response.print_json(file);
+        fprintf(file, "}\n");
+    }
+
+protected:
+    void complete(int id, const LiveTask &t, int completed_at)
+    {
+        const int turnaround = completed_at - t.arrive_at;
+        const int waiting = turnaround - t.duration;
+        const int response = t.first_run_at - t.arrive_at;
+
+        this->turnaround.add(turnaround);
+        this->waiting.add(waiting);
+        this->response.add(response);
+
+        if (this->task_output != NULL) {
+            fprintf(this->task_output,
+                    "{\"type\": \"task\", \"id\": %d, \"arrive_at\": %d, \"first_run_at\": %d, \"completed_at\": %d, "
+                    "\"turnaround\": %d, \"waiting\": %d, \"response\": %d}\n",
+                    id, t.arrive_at, t.first_run_at, completed_at,
+                    turnaround, waiting, response);
+        }
+    }
+};
+
+/**
+ * @brief Forward records to another sink, and tally them into `Metrics`
+ *
+ * A record is tallied once it is final, i.e. when the next one is pushed or at `finish`.
+ */
+class PlanSinkMetrics : public PlanSink
+{
+protected:
+    PlanSink &sink;
+    Metrics &metrics;
+
+public:
+    PlanSinkMetrics(PlanSink &sink, Metrics &metrics) : sink(sink), metrics(metrics) {}
+
+    void arrive(const Task &task)
+    {
+        this->metrics.arrive(task);
+        this->sink.arrive(task);
+    }
+
+    void push_back(Record record)
+    {
+        this->tally_back();
+        this->sink.push_back(record);
+    }
+
+    bool empty() const
+    {
+        return this->sink.empty();
+    }
+
+    Record &back()
+    {
+        return this->sink.back();
+    }
+
+    void finish()
+    {
+        this->tally_back();
+        this->sink.finish();
+    }
+
+protected:
+    void tally_back()
+    {
+        if (!this->sink.empty()) {
+            this->metrics.tally(this->sink.back());
+        }
+    }
+};
+
+enum EventType {
+    /** [*] → ready */
+    Arrive,
+    /** running → ready */
+    Interrupt,
+    /** running → [*] */
+    Complete,
+
+    PrivateUse,
+};
+
+struct Event {
+    EventType type;
+    int at;
+    /** Only for arrive events (the first task arriving at the moment), `NOT_APPLICABLE` otherwise */
+    int task_id;
+    /** the core it happens on, not applicable to arrive events */
+    int core;
+
+    Event(EventType type, int at, int task_id, int core = 0) : type(type), at(at), task_id(task_id), core(core) {}
+};
+
+#ifdef SCHEDULER_STATS
+
+/** Where the engine spends its work, for `EngineStats` */
+enum EngineHook {
+    /** anything outside the hooks below */
+    Other,
+    /** handling an event, indexed by `EventType` */
+    HandleArrive,
+    HandleInterrupt,
+    HandleComplete,
+    HandlePrivateUse,
+
+    RegisterEvent,
+    NextTaskToRun,
+    CanRunFor,
+};
+
+inline const char *engine_hook_name(EngineHook hook)
+{
+    static const char *const names[] = {"other", "handle_arrive", "handle_interrupt", "handle_complete",
+                                        "handle_private_use", "register_event", "next_task_to_run", "can_run_for"};
+    return names[hook];
+}
+
+inline EngineHook engine_hook_of(EventType type)
+{
+    return (EngineHook)(EngineHook::HandleArrive + type);
+}
+
+/**
+ * @brief Counters (and timers) of the event engine, for finding out why a run is slow
+ *
+ * Only compiled in with `-DSCHEDULER_STATS`, and timers only with `-DSCHEDULER_STATS=2`.
+ * Otherwise neither it nor the macros below leave anything in the code.
+ *
+ * - calls: how many times each hook runs. For `Handle*`, the number of events by type.
+ * - comparisons: how many queue positions are compared (both run queues and event queues) within each hook,
+ *   attributed to the innermost one.
+ * - nanoseconds: time spent in each hook, including nested ones.
+ * - preemptions: how many times a running task is put back before completing.
+ * - ready tasks and pending events: sampled after every event, both as distributions and as a time series.
+ *
+ * There is one per thread, and schedulers on the same thread add up.
+ */
+class EngineStats
+{
+public:
+    static constexpr int N_HOOKS = EngineHook::CanRunFor + 1;
+
+    long long calls[N_HOOKS] = {};
+    long long comparisons[N_HOOKS] = {};
+    long long nanoseconds[N_HOOKS] = {};
+    long long preemptions = 0;
+
+    Distribution ready_tasks;
+    Distribution pending_events;
+
+    /** A point in the time series */
+    struct Sample {
+        int at;
+        size_t ready_tasks;
+        size_t pending_events;
+    };
+    /** one sample every `sample_interval` events, at most `MAX_SAMPLES` */
+    vector<Sample> samples;
+
+    /** the hook running now */
+    EngineHook current = EngineHook::Other;
+
+protected:
+    static constexpr size_t MAX_SAMPLES = 256;
+    long long sample_interval = 1;
+    long long n_sampled = 0;
+
+public:
+    void count_comparison()
+    {
+        this->comparisons[this->current]++;
+    }
+
+    /** Record queue lengths after an event at `at` */
+    void sample(int at, size_t n_ready, size_t n_events)
+    {
+        this->ready_tasks.add((int)n_ready);
+        this->pending_events.add((int)n_events);
+
+        if (this->n_sampled % this->sample_interval == 0) {
+            if (this->samples.size() == MAX_SAMPLES) {
+                // Keep every other sample, and sample half as often.
+                for (size_t i = 0; i < MAX_SAMPLES / 2; i++) {
+                    this->samples[i] = this->samples[2 * i];
+                }
+                this->samples.resize(MAX_SAMPLES / 2);
+                this->sample_interval *= 2;
+            }
+            if (this->n_sampled % this->sample_interval == 0) {
+                this->samples.push_back(Sample{at, n_ready, n_events});
+            }
+        }
+        this->n_sampled++;
+    }
+
+    void print_json(FILE *file) const
+    {
+        fprintf(file, "{\"hooks\": {");
+        for (int h = 0; h < N_HOOKS; h++) {
+            fprintf(file, "%s\"%s\": {\"calls\": %lld, \"comparisons\": %lld",
+                    h > 0 ? ", " : "", engine_hook_name((EngineHook)h), this->calls[h], this->comparisons[h]);
+#if SCHEDULER_STATS >= 2
+            fprintf(file, ", \"nanoseconds\": %lld", this->nanoseconds[h]);
+#endif
+            fprintf(file, "}");
+        }
+
+        fprintf(file, "}, \"preemptions\": %lld, \"ready_tasks\": ", this->preemptions);
+        this->ready_tasks.print_json(file);
+        fprintf(file, ", \"pending_events\": ");
+        this->pending_events.print_json(file);
+
+        fprintf(file, ", \"samples\": [");
+        for (size_t i = 0; i < this->samples.size(); i++) {
+            const auto &s = this->samples[i];
+            fprintf(file, "%s[%d, %zu, %zu]", i > 0 ? ", " : "", s.at, s.ready_tasks, s.pending_events);
+        }
+        fprintf(file, "]}\n");
+    }
+
+    /** Print in the Prometheus text format. The time series is left out. */
+    void print_prometheus(FILE *file) const
+    {
+        fprintf(file, "# TYPE scheduler_hook_calls_total counter\n");
+        for (int h = 0; h < N_HOOKS; h++) {
+            fprintf(file, "scheduler_hook_calls_total{hook=\"%s\"} %lld\n", engine_hook_name((EngineHook)h), this->calls[h]);
+        }
+        fprintf(file, "# TYPE scheduler_hook_comparisons_total counter\n");
+        for (int h = 0; h < N_HOOKS; h++) {
+            fprintf(file, "scheduler_hook_comparisons_total{hook=\"%s\"} %lld\n", engine_hook_name((EngineHook)h), this->comparisons[h]);
+        }
+#if SCHEDULER_STATS >= 2
+        fprintf(file, "# TYPE scheduler_hook_seconds_total counter\n");
+        for (int h = 0; h < N_HOOKS; h++) {
+            fprintf(file, "scheduler_hook_seconds_total{hook=\"%s\"} %.9f\n", engine_hook_name((EngineHook)h), this->nanoseconds[h] * 1e-9);
+        }
+#endif
+        fprintf(file, "# TYPE scheduler_preemptions_total counter\n");
+        fprintf(file, "scheduler_preemptions_total %lld\n", this->preemptions);
+
+        print_prometheus_summary(file, "scheduler_ready_tasks", this->ready_tasks);
+        print_prometheus_summary(file, "scheduler_pending_events", this->pending_events);
+    }
+
+protected:
+    static void print_prometheus_summary(FILE *file, const char *name, const Distribution &d)
+    {
+        fprintf(file, "# TYPE %s summary\n", name);
+        for (auto q : {0.5, 0.95, 0.99}) {
+            fprintf(file, "%s{quantile=\"%g\"} %d\n", name, q, d.percentile(q));
+        }
+        fprintf(file, "%s_sum %.0f\n", name, d.mean() * d.size());
+        fprintf(file, "%s_count %lld\n", name, d.size());
+    }
+};
+
+inline thread_local EngineStats engine_stats;
+
+/** Attribute comparisons (and time) to `hook` until destructed */
+class EngineStatsScope
+{
+protected:
+    EngineHook previous;
+#if SCHEDULER_STATS >= 2
+    chrono::steady_clock::time_point start;
+#endif
+
+public:
+    EngineStatsScope(EngineHook hook) : previous(engine_stats.current)
+    {
+        engine_stats.current = hook;
+        engine_stats.calls[hook]++;
+#if SCHEDULER_STATS >= 2
+        this->start = chrono::steady_clock::now();
+#endif
+    }
+
+    ~EngineStatsScope()
+    {
+#if SCHEDULER_STATS >= 2
+        const auto elapsed = chrono::steady_clock::now() - this->start;
+        engine_stats.nanoseconds[engine_stats.current] += chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+#endif
+        engine_stats.current = this->previous;
+    }
+};
+
+/** Run `statement` on `engine_stats`, e.g. `ENGINE_STATS(count_comparison())` */
+#define ENGINE_STATS(statement) (engine_stats.statement)
+/** Attribute the rest of the block to `hook` */
+#define ENGINE_STATS_SCOPE(hook) EngineStatsScope engine_stats_scope(hook)
+/** Evaluate `expression` as `hook` */
+#define ENGINE_STATS_CALL(hook, expression) ([&] { ENGINE_STATS_SCOPE(hook); return expression; }())
+#else
+#define ENGINE_STATS(statement) ((void)0)
+#define ENGINE_STATS_SCOPE(hook) ((void)0)
+#define ENGINE_STATS_CALL(hook, expression) (expression)
+#endif
+
+/** 事件队列的实现 */
+enum EventQueueKind {
+    /** 二叉堆 */
+    BinaryHeap,
+    /** 日历队列 */
+    Calendar,
+};
+
+/** An event and when it was pushed, as stored in an `EventQueue` */
+struct QueuedEvent {
+    Event event;
+    /** the number of events pushed before this one */
+    unsigned long long order;
+
+    QueuedEvent(Event event, unsigned long long order) : event(event), order(order) {}
+
+    /**
+     * Whether `this` should be popped before `other`
+     *
+     * Events are ordered by `at`.
+     * At the same moment, `PrivateUse` goes first, then `Arrive`, then others by the order of pushing.
+     */
+    bool fires_before(const QueuedEvent &other) const
+    {
+        ENGINE_STATS(count_comparison());
+
+        if (this->event.at != other.event.at) {
+            return this->event.at < other.event.at;
+        }
+
+        if (this->rank() != other.rank()) {
+            return this->rank() < other.rank();
+        }
+
+        return this->order < other.order;
+    }
+
+protected:
+    int rank() const
+    {
+        switch (this->event.type) {
+        case EventType::PrivateUse:
+            return 0;
+        case EventType::Arrive:
+            return 1;
+        default:
+            return 2;
+        }
+    }
+};
+
+/** Events in the future, popped in the order of `QueuedEvent::fires_before` */
+class EventQueue
+{
+protected:
+    unsigned long long n_pushed = 0;
+
+public:
+    virtual ~EventQueue() {}
+
+    void push(Event event)
+    {
+        this->push(QueuedEvent(event, this->n_pushed));
+        this->n_pushed++;
+    }
+
+    /** Remove and return the first event. The queue must not be empty. */
+    virtual Event pop() = 0;
+
+    virtual bool empty() const = 0;
+
+    virtual size_t size() const = 0;
+
+    /** a copy of the same kind */
+    virtual unique_ptr<EventQueue> clone() const = 0;
+
+protected:
+    virtual void push(QueuedEvent event) = 0;
+};
+
+class EventQueueBinaryHeap : public EventQueue
+{
+protected:
+    struct FiresAfter {
+        bool operator()(const QueuedEvent &a, const QueuedEvent &b) const
+        {
+            return b.fires_before(a);
+        }
+    };
+
+    priority_queue<QueuedEvent, vector<QueuedEvent>, FiresAfter> heap;
+
+public:
+    Event pop()
+    {
+        auto event = this->heap.top().event;
+        this->heap.pop();
+        return event;
+    }
+
+    bool empty() const
+    {
+        return this->heap.empty();
+    }
+
+    size_t size() const
+    {
+        return this->heap.size();
+    }
+
+    unique_ptr<EventQueue> clone() const
+    {
+        return unique_ptr<EventQueue>(new EventQueueBinaryHeap(*this));
+    }
+
+protected:
+    void push(QueuedEvent event)
+    {
+        this->heap.push(event);
+    }
+};
+
+/**
+ * @brief Calendar queue (R. Brown, 1988)
+ *
+ * Events are hashed into buckets by `at / width`, like days in a year.
+ * Popping walks the buckets from the current day on, so both push and pop are O(1) on average.
+ * The calendar is resized (and `width` re-estimated) when the number of events doubles or halves.
+ */
+class EventQueueCalendar : public EventQueue
+{
+protected:
+    /** each bucket is sorted in descending order, so that the first event is at the back */
+    vector<vector<QueuedEvent>> buckets;
+    /** the length of a bucket (a day) */
+    int width;
+    size_t n_events;
+
+    /** the bucket that holds `last_at` */
+    size_t current;
+    /** the end of `current` bucket in this year */
+    long long bucket_top;
+    /** when the last popped event happened */
+    int last_at;
+
+public:
+    EventQueueCalendar() : buckets(2), width(1), n_events(0), current(0), bucket_top(1), last_at(0) {}
+
+    Event pop()
+    {
+        assert(this->n_events > 0);
+
+        while (true) {
+            // 1. Walk through a year from `current` day.
+            for (size_t i = 0; i < this->buckets.size(); i++) {
+                auto &bucket = this->buckets[this->current];
+                if (!bucket.empty() && bucket.back().event.at < this->bucket_top) {
+                    return this->take_from(bucket);
+                }
+
+                this->current = (this->current + 1) % this->buckets.size();
+                this->bucket_top += this->width;
+            }
+
+            // 2. Nothing in this year. Jump to the earliest event directly.
+            const QueuedEvent *first = NULL;
+            for (auto &&bucket : this->buckets) {
+                if (!bucket.empty() && (first == NULL || bucket.back().fires_before(*first))) {
+                    first = &bucket.back();
+                }
+            }
+            this->go_to(first->event.at);
+        }
+    }
+
+    bool empty() const
+    {
+        return this->n_events == 0;
+    }
+
+    size_t size() const
+    {
+        return this->n_events;
+    }
+
+    unique_ptr<EventQueue> clone() const
+    {
+        return unique_ptr<EventQueue>(new EventQueueCalendar(*this));
+    }
+
+protected:
+    void push(QueuedEvent event)
+    {
+        this->insert(event);
+        this->n_events++;
+
+        if (this->n_events > 2 * this->buckets.size()) {
+            this->resize(2 * this->buckets.size());
+        }
+    }
+
+    void insert(QueuedEvent event)
+    {
+        auto &bucket = this->buckets[this->bucket_of(event.event.at)];
+
+        // Find the last event that fires after `event`, and insert after it.
+        auto where = bucket.end();
+        while (where != bucket.begin() && prev(where)->fires_before(event)) {
+            --where;
+        }
+        bucket.insert(where, event);
+    }
+
+    Event take_from(vector<QueuedEvent> &bucket)
+    {
+        const auto event = bucket.back().event;
+        bucket.pop_back();
+        this->n_events--;
+        this->last_at = event.at;
+
+        if (this->buckets.size() > 2 && this->n_events < this->buckets.size() / 2) {
+            this->resize(this->buckets.size() / 2);
+        }
+
+        return event;
+    }
+
+    size_t bucket_of(int at) const
+    {
+        return (size_t)(at / this->width) % this->buckets.size();
+    }
+
+    /** Set `current` and `bucket_top` to the day of `at` */
+    void go_to(int at)
+    {
+        this->current = this->bucket_of(at);
+        this->bucket_top = ((long long)(at / this->width) + 1) * this->width;
+    }
+
+    void resize(size_t n_buckets)
+    {
+        vector<QueuedEvent> all;
+        all.reserve(this->n_events);
+        for (auto &&bucket : this->buckets) {
+            all.insert(all.end(), bucket.begin(), bucket.end());
+        }
+        sort(all.begin(), all.end(), [](const QueuedEvent &a, const QueuedEvent &b) {
+            return a.fires_before(b);
+        });
+
+        this->width = this->estimate_width(all);
+        this->buckets = vector<vector<QueuedEvent>>(n_buckets);
+        // Insert from the last, so that each insertion ends at the back of the bucket.
+        for (auto e = all.rbegin(); e != all.rend(); ++e) {
+            this->buckets[this->bucket_of(e->event.at)].push_back(*e);
+        }
+
+        this->go_to(this->last_at);
+    }
+
+    /**
+     * Estimate a good bucket width from the first few events (sorted)
+     *
+     * About three events a day works well according to Brown.
+     */
+    static int estimate_width(const vector<QueuedEvent> &sorted)
+    {
+        const size_t n_samples = min(sorted.size(), (size_t)25);
+        if (n_samples < 2) {
+            return 1;
+        }
+
+        const long long span = (long long)sorted[n_samples - 1].event.at - sorted[0].event.at;
+        return max(1LL, 3 * span / (long long)(n_samples - 1));
+    }
+};
+
+inline unique_ptr<EventQueue> make_event_queue(EventQueueKind kind)
+{
+    switch (kind) {
+    case EventQueueKind::Calendar:
+        return unique_ptr<EventQueue>(new EventQueueCalendar());
+    case EventQueueKind::BinaryHeap:
+    default:
+        return unique_ptr<EventQueue>(new EventQueueBinaryHeap());
+    }
+}
+
+/** Index of a task in a `TaskPool` */
+typedef int TaskSlot;
+
+/**
+ * @brief Ready and running tasks, stored as a structure of arrays
+ *
+ * Each field of `TaskRuntime` is an array indexed by `TaskSlot`, so reading a field of many tasks touches contiguous memory.
+ * A slot stays valid until erased, and erased slots are reused via a free list.
+ * Therefore nothing is allocated once the arrays are as large as the most tasks alive at a time.
+ */
+class TaskPool
+{
+public:
+    vector<int> id;
+    vector<int> duration_left;
+    vector<int> priority;
+    vector<int> quantum;
+    vector<int> arrival;
+    vector<int> core;
+    vector<long long> vruntime;
+
+protected:
+    /** for a free slot, the next free slot, `NOT_APPLICABLE` for the last */
+    vector<TaskSlot> next_free;
+    TaskSlot first_free = NOT_APPLICABLE;
+    size_t n_alive = 0;
+
+public:
+    TaskSlot insert(const TaskRuntime &task)
+    {
+        TaskSlot slot;
+        if (this->first_free != NOT_APPLICABLE) {
+            slot = this->first_free;
+            this->first_free = this->next_free[slot];
+        } else {
+            slot = this->id.size();
+            for (auto field : {&this->id, &this->duration_left, &this->priority, &this->quantum, &this->arrival, &this->core}) {
+                field->push_back(0);
+            }
+            this->vruntime.push_back(0);
+            this->next_free.push_back(NOT_APPLICABLE);
+        }
+
+        this->id[slot] = task.id;
+        this->duration_left[slot] = task.duration_left;
+        this->priority[slot] = task.priority;
+        this->quantum[slot] = task.quantum;
+        this->arrival[slot] = task.arrival;
+        this->core[slot] = task.core;
+        this->vruntime[slot] = task.vruntime;
+
+        this->n_alive++;
+        return slot;
+    }
+
+    /** Copy the task out as a `TaskRuntime` */
+    TaskRuntime get(TaskSlot slot) const
+    {
+        TaskRuntime task(Task{this->id[slot], 0, this->duration_left[slot], this->priority[slot], this->quantum[slot]},
+                         this->arrival[slot]);
+        task.core = this->core[slot];
+        task.vruntime = this->vruntime[slot];
+        return task;
+    }
+
+    void erase(TaskSlot slot)
+    {
+        this->next_free[slot] = this->first_free;
+        this->first_free = slot;
+        this->n_alive--;
+    }
+
+    /** the number of tasks alive */
+    size_t size() const
+    {
+        return this->n_alive;
+    }
+};
+
+/**
+ * @brief Order tasks by `Key`, then by arrival
+ *
+ * @tparam Key a field of `TaskPool`, e.g. `&TaskPool::duration_left`
+ */
+template <auto Key>
+struct TaskSlotLess {
+    const TaskPool *tasks;
+
+    bool operator()(TaskSlot a, TaskSlot b) const
+    {
+        ENGINE_STATS(count_comparison());
+
+        const auto &key = this->tasks->*Key;
+        if (key[a] != key[b]) {
+            return key[a] < key[b];
+        }
+        return this->tasks->arrival[a] < this->tasks->arrival[b];
+    }
+};
+
+/** Ready tasks, the one with the smallest `Key` first */
+template <auto Key>
+class ReadyQueue : public IndexedHeap<TaskSlot, TaskSlotLess<Key>>
+{
+public:
+    ReadyQueue(TaskPool &tasks) : IndexedHeap<TaskSlot, TaskSlotLess<Key>>(TaskSlotLess<Key>{&tasks}) {}
+    /** Copy `other` to order a copy of its `TaskPool` */
+    ReadyQueue(const ReadyQueue &other, TaskPool &tasks) : IndexedHeap<TaskSlot, TaskSlotLess<Key>>(other, TaskSlotLess<Key>{&tasks}) {}
+};
+
+/** Ready tasks, first in, first out, in a ring buffer */
+class FifoQueue
+{
+protected:
+    /** its size is a power of two */
+    vector<TaskSlot> ring;
+    /** where the first task is in `ring` */
+    size_t head;
+    size_t n_tasks;
+
+public:
+    FifoQueue(TaskPool &tasks) : ring(16), head(0), n_tasks(0) {}
+    FifoQueue(const FifoQueue &other, TaskPool &tasks) : FifoQueue(other) {}
+
+    void push(TaskSlot task)
+    {
+        if (this->n_tasks == this->ring.size()) {
+            this->grow();
+        }
+        this->ring[(this->head + this->n_tasks) & (this->ring.size() - 1)] = task;
+        this->n_tasks++;
+    }
+
+    TaskSlot pop()
+    {
+        assert(!this->empty());
+        const auto task = this->ring[this->head];
+        this->head = (this->head + 1) & (this->ring.size() - 1);
+        this->n_tasks--;
+        return task;
+    }
+
+    bool empty() const
+    {
+        return this->n_tasks == 0;
+    }
+
+    size_t size() const
+    {
+        return this->n_tasks;
+    }
+
+protected:
+    /** Double `ring`, and move tasks to the front */
+    void grow()
+    {
+        vector<TaskSlot> bigger(2 * this->ring.size());
+        for (size_t i = 0; i < this->n_tasks; i++) {
+            bigger[i] = this->ring[(this->head + i) & (this->ring.size() - 1)];
+        }
+        this->ring.swap(bigger);
+        this->head = 0;
+    }
+};
+
+struct TaskSlotArrivesEarlier {
+    const TaskPool *tasks;
+
+    bool operator()(TaskSlot a, TaskSlot b) const
+    {
+        ENGINE_STATS(count_comparison());
+
+        return this->tasks->arrival[a] < this->tasks->arrival[b];
+    }
+};
+
+/**
+ * @brief Ready tasks for dynamic priority, the one with the smallest `priority` first
+ *
+ * While a task is in the queue, its `priority` is kept by the queue, and the field is out of date.
+ */
+class DynamicPriorityQueue
+{
+protected:
+    TaskPool &tasks;
+    AgingQueue<TaskSlot, TaskSlotArrivesEarlier> queue;
+
+public:
+    DynamicPriorityQueue(TaskPool &tasks) : tasks(tasks), queue(TaskSlotArrivesEarlier{&tasks}) {}
+    DynamicPriorityQueue(const DynamicPriorityQueue &other, TaskPool &tasks)
+        : tasks(tasks), queue(other.queue, TaskSlotArrivesEarlier{&tasks}) {}
+
+    void push(TaskSlot task)
+    {
+        this->queue.push(task, this->tasks.priority[task]);
+    }
+
+    TaskSlot pop()
+    {
+        int priority;
+        auto task = this->queue.pop(priority);
+        this->tasks.priority[task] = priority;
+        return task;
+    }
+
+    bool empty() const
+    {
+        return this->queue.empty();
+    }
+
+    size_t size() const
+    {
+        return this->queue.size();
+    }
+
+    /** Increase every task's priority (i.e. decrease the number) by one, but not above zero */
+    void age()
+    {
+        this->queue.age();
+    }
+};
+
+/**
+ * @brief Ready tasks in several levels for the multilevel feedback queue, the first of the highest level first
+ *
+ * A task's level is its `priority`, 0 being the highest, and it is capped at the last level on `push`.
+ * Each level is a FIFO, and `non_empty` has bit `l` set iff level `l` has tasks,
+ * so `pop` finds the highest level by find-first-set, in O(1) regardless of the number of tasks.
+ */
+class MultilevelQueue
+{
+protected:
+    TaskPool &tasks;
+    vector<FifoQueue> levels;
+    unsigned long long non_empty;
+    size_t n_tasks;
+
+public:
+    static constexpr int MAX_LEVELS = 64;
+
+    MultilevelQueue(TaskPool &tasks) : tasks(tasks), non_empty(0), n_tasks(0)
+    {
+        this->set_n_levels(1);
+    }
+    MultilevelQueue(const MultilevelQueue &other, TaskPool &tasks)
+        : tasks(tasks), levels(other.levels), non_empty(other.non_empty), n_tasks(other.n_tasks) {}
+
+    void set_n_levels(int n_levels)
+    {
+        assert(0 < n_levels && n_levels <= MAX_LEVELS);
+        assert(this->empty());
+        this->levels.assign(n_levels, FifoQueue(this->tasks));
+    }
+
+    void push(TaskSlot task)
+    {
+        auto &level = this->tasks.priority[task];
+        level = min(max(level, 0), (int)this->levels.size() - 1);
+
+        this->levels[level].push(task);
+        this->non_empty |= 1ULL << level;
+        this->n_tasks++;
+    }
+
+    TaskSlot pop()
+    {
+        assert(!this->empty());
+        const int level = __builtin_ctzll(this->non_empty);
+
+        const auto task = this->levels[level].pop();
+        if (this->levels[level].empty()) {
+            this->non_empty &= ~(1ULL << level);
+        }
+        this->n_tasks--;
+        return task;
+    }
+
+    bool empty() const
+    {
+        return this->n_tasks == 0;
+    }
+
+    size_t size() const
+    {
+        return this->n_tasks;
+    }
+
+    /** Move every task to the highest level, higher levels and earlier tasks first */
+    void boost()
+    {
+        auto &top = this->levels[0];
+        for (size_t l = 1; l < this->levels.size(); l++) {
+            while (!this->levels[l].empty()) {
+                const auto task = this->levels[l].pop();
+                this->tasks.priority[task] = 0;
+                top.push(task);
+            }
+        }
+        this->non_empty = top.empty() ? 0 : 1;
+    }
+};
+
+/**
+ * @brief Ready tasks for completely fair scheduling, the one with the smallest `vruntime` first
+ *
+ * A task entering the queue for the first time starts from `min_vruntime`,
+ * so that it neither starves others nor is starved by those that have run for long.
+ *
+ * It is a heap rather than a balanced tree:
+ * only the leftmost task is ever taken, and the heap does so in O(log n) without a node per task.
+ */
+class FairQueue
+{
+protected:
+    TaskPool &tasks;
+    ReadyQueue<&TaskPool::vruntime> queue;
+    /** never decreases, see `pop` */
+    long long min_vruntime;
+    /** the sum of `weight_of` the tasks queued */
+    long long total_weight;
+
+public:
+    /** the weight of priority 20, and the unit of `vruntime` per time unit at that weight */
+    static constexpr long long NICE_0_WEIGHT = 1024;
+
+    FairQueue(TaskPool &tasks) : tasks(tasks), queue(tasks), min_vruntime(0), total_weight(0) {}
+    FairQueue(const FairQueue &other, TaskPool &tasks)
+        : tasks(tasks), queue(other.queue, tasks), min_vruntime(other.min_vruntime), total_weight(other.total_weight) {}
+
+    /**
+     * @brief The weight of a task
+     *
+     * Priorities 0–39 are taken as Linux's nice −20–19: each level has about 1.25× the weight of the next.
+     */
+    static long long weight(int priority)
+    {
+        static const int weights[40] = {
+            88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+            9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+            1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+            110, 87, 70, 56, 45, 36, 29, 23, 18, 15};
+        return weights[min(max(priority, 0), 39)];
+    }
+
+    long long weight_of(TaskSlot task) const
+    {
+        return weight(this->tasks.priority[task]);
+    }
+
+    void push(TaskSlot task)
+    {
+        auto &vruntime = this->tasks.vruntime[task];
+        if (vruntime == NOT_APPLICABLE) {
+            vruntime = this->min_vruntime;
+        }
+
+        this->queue.push(task);
+        this->total_weight += this->weight_of(task);
+    }
+
+    /** Take the leftmost task, and advance `min_vruntime` to it */
+    TaskSlot pop()
+    {
+        const auto task = this->queue.pop();
+        this->total_weight -= this->weight_of(task);
+        this->min_vruntime = max(this->min_vruntime, this->tasks.vruntime[task]);
+        return task;
+    }
+
+    bool empty() const
+    {
+        return this->queue.empty();
+    }
+
+    size_t size() const
+    {
+        return this->queue.size();
+    }
+
+    long long queued_weight() const
+    {
+        return this->total_weight;
+    }
+
+    /** `min_vruntime`, for saving the state */
+    long long vruntime_floor() const
+    {
+        return this->min_vruntime;
+    }
+
+    void set_vruntime_floor(long long min_vruntime)
+    {
+        this->min_vruntime = min_vruntime;
+    }
+};
+
+/**
+ * @brief Tasks on a core, or on all cores if shared
+ *
+ * `tasks` holds ready and running tasks.
+ * The ready ones are also queued in the order of the policy, and the running ones are taken out of the queue.
+ *
+ * @tparam Queue `FifoQueue`, `ReadyQueue`, `DynamicPriorityQueue`, etc., constructed from `tasks`,
+ * or copied from another queue with `tasks`
+ */
+template <typename Queue>
+class RunQueue
+{
+public:
+    TaskPool tasks;
+    Queue queue;
+
+    RunQueue() : queue(this->tasks) {}
+    /** `queue` refers to `tasks`, so the copy of `queue` is rebound to the copy of `tasks` */
+    RunQueue(const RunQueue &other) : tasks(other.tasks), queue(other.queue, this->tasks) {}
+
+    void push(TaskSlot task)
+    {
+        this->queue.push(task);
+    }
+
+    /** Take the next task to run */
+    TaskSlot pop()
+    {
+        return this->queue.pop();
+    }
+
+    /** Whether no task is ready */
+    bool empty() const
+    {
+        return this->queue.empty();
+    }
+
+    /** the number of ready tasks */
+    size_t size() const
+    {
+        return this->queue.size();
+    }
+};
+
+class Scheduler;
+
+/** Where snapshots go while running, see `IncrementalScheduler` */
+class SnapshotSink
+{
+public:
+    virtual ~SnapshotSink() {}
+
+    /** Whether to take a snapshot before the tasks arriving at `at` are admitted, which would copy `n_tasks` ready and running tasks */
+    virtual bool wants_snapshot(int at, size_t n_tasks) = 0;
+    /** Take over `snapshot`, which continues from just before the arrivals at `at` when `resume`d */
+    virtual void save_snapshot(int at, Scheduler *snapshot) = 0;
+};
+
+/**
+ * @brief A scheduler of the algorithm chosen at run time
+ *
+ * Only the entry points are virtual.
+ * The algorithms themselves are composed at compile time, see `SchedulerEngine`.
+ */
+class Scheduler
+{
+public:
+    virtual ~Scheduler() {}
+
+    Plan run()
+    {
+        PlanCollector plan;
+        this->run(plan);
+        return plan.plan;
+    }
+
+    /**
+     * @brief Run and push records to `plan`
+     *
+     * Tasks are taken from `arrivals` only when the clock reaches them,
+     * so memory is bounded by the number of tasks alive.
+     */
+    virtual void run(PlanSink &plan) = 0;
+
+    /** Modify every task when it arrives, without touching `arrivals` */
+    virtual void override_tasks(TaskOverrides overrides) = 0;
+
+    /** Send snapshots to `snapshots` while running, or stop if `NULL` */
+    virtual void take_snapshots(SnapshotSink *snapshots) = 0;
+
+    /**
+     * @brief Continue running from the current state, e.g. a snapshot
+     *
+     * `arrivals` should be at the next task to arrive, which may have been added after the snapshot.
+     */
+    virtual void resume(PlanSink &plan) = 0;
+
+    /** a deep copy of the state, sharing `arrivals` */
+    virtual Scheduler *clone() const = 0;
+
+    /**
+     * @brief Encode the state, for `load` in another process
+     *
+     * The state is what `clone` copies: ready and running tasks, pending events and counters, but not `arrivals`.
+     * Queues are written in the order they would pop, so the bytes do not depend on their layout.
+     * Cores of a multiprocessor are not supported.
+     */
+    virtual void save(VarintWriter &out) const = 0;
+
+    /**
+     * @brief Restore the state written by `save`
+     *
+     * The scheduler should be newly constructed with the same arguments as the one saved.
+     *
+     * @return `false` if the data is malformed
+     */
+    virtual bool load(VarintReader &in) = 0;
+};
+
+/**
+ * @brief The event loop and the default hooks of all algorithms
+ *
+ * Hooks (`handle_event`, `on_arrive`, `on_complete`, `on_interrupt`, `next_task_to_run` and `register_event`)
+ * are called on `derived()`, so an algorithm overrides one by hiding it (CRTP).
+ * The calls are resolved at compile time and can be inlined into the loop.
+ *
+ * @tparam Derived the final scheduler
+ * @tparam Queue see `RunQueue`
+ */
+template <typename Derived, typename Queue>
+class SchedulerEngine : public Scheduler
+{
+protected:
+    /** tasks that have not arrived yet */
+    Arrivals &arrivals;
+    /** the task whose arrive event is being handled */
+    Task arriving_task;
+    /** the arrival order of `arriving_task` */
+    int arriving_order;
+    /** applied to every arriving task */
+    TaskOverrides overrides;
+
+    /** ready and running tasks */
+    shared_ptr<RunQueue<Queue>> run_queue;
+
+    /** the running task in `run_queue->tasks`, `NOT_APPLICABLE` if nothing is running */
+    TaskSlot running_task;
+
+    /** events in the future */
+    shared_ptr<EventQueue> events;
+
+    /** the core it schedules, 0 for uniprocessor */
+    int core;
+    /** the number of times a task starts running here after running on another core */
+    long long n_migrations;
+
+    /** the number of tasks arrived, uniprocessor only */
+    int n_arrived;
+    /** uniprocessor only, `NULL` if not wanted */
+    SnapshotSink *snapshots;
+
+public:
+    SchedulerEngine(Arrivals &arrivals, EventQueueKind queue_kind)
+        : arrivals(arrivals), arriving_task(), arriving_order(0),
+          run_queue(make_shared<RunQueue<Queue>>()), running_task(NOT_APPLICABLE),
+          events(make_event_queue(queue_kind)), core(0), n_migrations(0), n_arrived(0), snapshots(NULL) {}
+
+    using Scheduler::run;
+
+    void run(PlanSink &plan)
+    {
+        this->register_next_arrival();
+        this->resume(plan);
+    }
+
+    void resume(PlanSink &plan)
+    {
+        while (!this->events->empty()) {
+            auto event = this->events->pop();
+            if (event.type == EventType::Arrive) {
+                if (this->snapshots != NULL && this->snapshots->wants_snapshot(event.at, this->working_tasks().size())) {
+                    this->save_snapshot(event);
+                }
+
+                // Admit every task arriving now, then decide once.
+                do {
+                    const auto task = this->arrivals.peek();
+                    this->arrivals.pop();
+
+                    this->admit(Event(EventType::Arrive, event.at, task.id), task, this->n_arrived, plan);
+                    this->n_arrived++;
+                } while (!this->arrivals.empty() && this->arrivals.peek().arrive_at == event.at);
+                this->register_next_arrival();
+
+                this->wake(event, plan);
+            } else {
+                this->handle(event, plan);
+            }
+
+            ENGINE_STATS(sample(event.at, this->run_queue->size(), this->events->size()));
+        }
+
+        plan.finish();
+    }
+
+    void override_tasks(TaskOverrides overrides)
+    {
+        this->overrides = overrides;
+    }
+
+    void take_snapshots(SnapshotSink *snapshots)
+    {
+        this->snapshots = snapshots;
+    }
+
+    Scheduler *clone() const
+    {
+        return new Derived(static_cast<const Derived &>(*this));
+    }
+
+    void save(VarintWriter &out) const
+    {
+        out.write(this->n_arrived);
+        out.write(this->n_migrations);
+
+        // The running task, then ready tasks in the order they would run
+        RunQueue<Queue> ready(*this->run_queue);
+        out.write(this->running_task != NOT_APPLICABLE);
+        out.write(ready.size());
+        if (this->running_task != NOT_APPLICABLE) {
+            ready.tasks.get(this->running_task).save(out);
+        }
+        while (!ready.empty()) {
+            const auto task = ready.pop();
+            ready.tasks.get(task).save(out);
+        }
+
+        auto events = this->events->clone();
+        out.write(events->size());
+        while (!events->empty()) {
+            const auto e = events->pop();
+            for (long long v : {(int)e.type, e.at, e.task_id, e.core}) {
+                out.write(v);
+            }
+        }
+
+        this->derived().save_extra(out);
+    }
+
+    bool load(VarintReader &in)
+    {
+        assert(this->idle() && this->events->empty());
+
+        this->n_arrived = in.read();
+        this->n_migrations = in.read();
+
+        const bool running = in.read() != 0;
+        const long long n_ready = in.read();
+        if (running) {
+            this->running_task = this->working_tasks().insert(TaskRuntime::load(in));
+        }
+        for (long long i = 0; i < n_ready && in.ok(); i++) {
+            this->run_queue->push(this->working_tasks().insert(TaskRuntime::load(in)));
+        }
+
+        // Pushed in the order they were popped, so ties keep their order.
+        const long long n_events = in.read();
+        for (long long i = 0; i < n_events && in.ok(); i++) {
+            const auto type = in.read();
+            const int at = in.read();
+            const int task_id = in.read();
+            const int core = in.read();
+            if (type < EventType::Arrive || type > EventType::PrivateUse) {
+                return false;
+            }
+            this->events->push(Event((EventType)type, at, task_id, core));
+        }
+
+        return in.ok() && this->derived().load_extra(in) && in.ok();
+    }
+
+    // For `MultiprocessorEngine`
+
+    /**
+     * @brief Join `leader` as another core
+     *
+     * The event queue is shared, and so is the run queue if `share_run_queue`.
+     */
+    void join(const Derived &leader, int core, bool share_run_queue)
+    {
+        this->core = core;
+        this->events = leader.events;
+
+        if (share_run_queue) {
+            this->run_queue = leader.run_queue;
+            this->running_task = NOT_APPLICABLE;
+        }
+    }
+
+    EventQueue &event_queue()
+    {
+        return *this->events;
+    }
+
+    /**
+     * @brief Handle the arrive event of `task`, which is the `order`-th to arrive
+     *
+     * The task is only queued. Call `wake` after admitting all tasks arriving at the moment.
+     */
+    void admit(Event event, const Task &task, int order, PlanSink &plan)
+    {
+        this->arriving_task = task;
+        this->arriving_order = order;
+        plan.arrive(task);
+
+        ENGINE_STATS_SCOPE(engine_hook_of(event.type));
+        this->derived().handle_event(event, plan);
+    }
+
+    /** Decide what to run at `event.at` if nothing is running, e.g. after a batch of arrivals */
+    void wake(Event event, PlanSink &plan)
+    {
+        if (this->nothing_running()) {
+            this->derived().on_interrupt(event, plan);
+        }
+    }
+
+    /** Handle an event other than arrivals */
+    void handle(Event event, PlanSink &plan)
+    {
+        ENGINE_STATS_SCOPE(engine_hook_of(event.type));
+        this->derived().handle_event(event, plan);
+    }
+
+    bool nothing_running()
+    {
+        return this->running_task == NOT_APPLICABLE;
+    }
+
+    /** Whether nothing is running and nothing is ready */
+    bool idle()
+    {
+        return this->nothing_running() && this->run_queue->empty();
+    }
+
+    /** the number of ready tasks */
+    size_t n_ready() const
+    {
+        return this->run_queue->size();
+    }
+
+    /** the number of ready and running tasks */
+    size_t n_tasks() const
+    {
+        return this->run_queue->tasks.size();
+    }
+
+    long long migrations() const
+    {
+        return this->n_migrations;
+    }
+
+    /** Move the next ready task to `thief`, which may start running it at `now` */
+    void migrate_to(Derived &thief, int now, PlanSink &plan)
+    {
+        const auto task = this->run_queue->pop();
+        const TaskRuntime runtime = this->working_tasks().get(task);
+        this->working_tasks().erase(task);
+
+        thief.accept(runtime, now, plan);
+    }
+
+protected:
+    /** Copy the state deeply for a snapshot, except `arrivals`. Cores of a multiprocessor are not supported. */
+    SchedulerEngine(const SchedulerEngine &other)
+        : Scheduler(other), arrivals(other.arrivals), arriving_task(other.arriving_task), arriving_order(other.arriving_order),
+          overrides(other.overrides), run_queue(make_shared<RunQueue<Queue>>(*other.run_queue)), running_task(other.running_task),
+          events(other.events->clone()), core(other.core), n_migrations(other.n_migrations),
+          n_arrived(other.n_arrived), snapshots(other.snapshots) {}
+
+    Derived &derived()
+    {
+        return static_cast<Derived &>(*this);
+    }
+
+    const Derived &derived() const
+    {
+        return static_cast<const Derived &>(*this);
+    }
+
+    /** Write the algorithm's own state, besides tasks and events, see `save` */
+    void save_extra(VarintWriter &out) const {}
+
+    /** Read what `save_extra` writes */
+    bool load_extra(VarintReader &in)
+    {
+        return true;
+    }
+
+    /**
+     * @brief Send a copy to `snapshots`, with the popped arrive `event` put back
+     *
+     * Every decision so far only depends on tasks arriving before `event.at`,
+     * as SRTF looks no further than the next arrival, which is `event.at`.
+     * Therefore the snapshot stays valid as long as no task is added before `event.at`.
+     */
+    void save_snapshot(Event event)
+    {
+        auto snapshot = new Derived(this->derived());
+        snapshot->events->push(event);
+        this->snapshots->save_snapshot(event.at, snapshot);
+    }
+
+    TaskPool &working_tasks()
+    {
+        return this->run_queue->tasks;
+    }
+
+    /** Take in a task migrated from another core at `now` */
+    void accept(TaskRuntime task, int now, PlanSink &plan)
+    {
+        this->run_queue->push(this->working_tasks().insert(task));
+
+        if (this->nothing_running()) {
+            this->derived().on_interrupt(Event(EventType::Interrupt, now, NOT_APPLICABLE, this->core), plan);
+        }
+    }
+
+    /**
+     * Get the arriving task and convert to `TaskRuntime`
+     *
+     * Only for the arrive event being handled.
+     */
+    TaskRuntime get_task(int id)
+    {
+        assert(this->arriving_task.id == id);
+        TaskRuntime task(this->arriving_task, this->arriving_order);
+        this->overrides.apply(task);
+        return task;
+    }
+
+    void register_event(Event event)
+    {
+        event.core = this->core;
+        this->events->push(event);
+    }
+
+    /**
+     * @brief Register the next batch of arrivals, if any
+     *
+     * `arrivals` works as a cursor: only one arrive event is registered at a time, for all tasks arriving at that moment.
+     * The next one is registered after the batch is admitted, so the next arrival is always `arrivals.peek()`.
+     */
+    void register_next_arrival()
+    {
+        if (!this->arrivals.empty()) {
+            const auto &t = this->arrivals.peek();
+            this->events->push(Event(
+                EventType::Arrive,
+                t.arrive_at,
+                t.id));
+        }
+    };
+
+    /** Set `running_task`, and count migrations */
+    void start_running(TaskSlot task)
+    {
+        auto &core = this->working_tasks().core[task];
+        if (core != NOT_APPLICABLE && core != this->core) {
+            this->n_migrations++;
+        }
+        core = this->core;
+
+        this->running_task = task;
+    }
+
+    void handle_event(Event event, PlanSink &plan)
+    {
+        switch (event.type) {
+        case EventType::Arrive:
+            this->derived().on_arrive(event, plan);
+            break;
+        case EventType::Complete:
+            this->derived().on_complete(event, plan);
+            break;
+        case EventType::Interrupt:
+            this->derived().on_interrupt(event, plan);
+            break;
+        case EventType::PrivateUse:
+            // Only registered by derived schedulers, which handle it before calling here.
+            assert(false);
+            break;
+        }
+    }
+
+    void on_arrive(Event event, PlanSink &plan)
+    {
+        this->run_queue->push(this->working_tasks().insert(this->get_task(event.task_id)));
+    }
+
+    void on_complete(Event event, PlanSink &plan)
+    {
+        this->working_tasks().erase(this->running_task);
+        this->running_task = NOT_APPLICABLE;
+
+        this->derived().on_interrupt(event, plan);
+    }
+
+    void on_interrupt(Event event, PlanSink &plan)
+    {
+        if (this->run_queue->empty()) {
+            this->running_task = NOT_APPLICABLE;
+            return;
+        }
+
+        this->start_running(ENGINE_STATS_CALL(EngineHook::NextTaskToRun, this->derived().next_task_to_run()));
+        const auto &tasks = this->working_tasks();
+        const auto task = this->running_task;
+        auto end_at = event.at + tasks.duration_left[task];
+        plan.push_back(Record(tasks.id[task], event.at, end_at, tasks.priority[task], this->core));
+
+        ENGINE_STATS_CALL(EngineHook::RegisterEvent, this->derived().register_event(Event(EventType::Complete, end_at, NOT_APPLICABLE)));
+    };
+
+    /** Default implementation: the first in `run_queue` */
+    TaskSlot next_task_to_run()
+    {
+        return this->run_queue->pop();
+    };
+};
+
+class SchedulerFCFS final : public SchedulerEngine<SchedulerFCFS, FifoQueue>
+{
+public:
+    SchedulerFCFS(Arrivals &arrivals, EventQueueKind queue_kind) : SchedulerEngine(arrivals, queue_kind) {}
+};
+
+class SchedulerSJF final : public SchedulerEngine<SchedulerSJF, ReadyQueue<&TaskPool::duration_left>>
+{
+public:
+    SchedulerSJF(Arrivals &arrivals, EventQueueKind queue_kind) : SchedulerEngine(arrivals, queue_kind) {}
+};
+
+/**
+ * @brief Preemptive schedulers, with more hooks
+ *
+ * `handle_last_running_task`, `record_running_task` and `can_run_for` are called on `derived()` as well.
+ */
+template <typename Derived, typename Queue>
+class SchedulerPreemptive : public SchedulerEngine<Derived, Queue>
+{
+    friend class SchedulerEngine<Derived, Queue>;
+
+public:
+    SchedulerPreemptive(Arrivals &arrivals, EventQueueKind queue_kind)
+        : SchedulerEngine<Derived, Queue>(arrivals, queue_kind) {}
+
+protected:
+    void on_interrupt(Event event, PlanSink &plan)
+    {
+        this->derived().handle_last_running_task();
+
+        if (this->run_queue->empty()) {
+            return;
+        }
+        this->start_running(ENGINE_STATS_CALL(EngineHook::NextTaskToRun, this->derived().next_task_to_run()));
+
+        const auto duration = ENGINE_STATS_CALL(EngineHook::CanRunFor, this->derived().can_run_for(event.at));
+        auto &duration_left = this->working_tasks().duration_left[this->running_task];
+        duration_left -= duration;
+
+        auto end_at = event.at + duration;
+        this->derived().record_running_task(plan, event.at, end_at);
+
+        const auto next = duration_left > 0 ? EventType::Interrupt : EventType::Complete;
+        ENGINE_STATS_CALL(EngineHook::RegisterEvent, this->derived().register_event(Event(next, end_at, NOT_APPLICABLE)));
+    }
+
+    /** Put the interrupted task back to `run_queue` */
+    void handle_last_running_task()
+    {
+        if (!this->nothing_running()) {
+            this->run_queue->push(this->running_task);
+            ENGINE_STATS(preemptions++);
+        }
+
+        this->running_task = NOT_APPLICABLE;
+    }
+
+    void record_running_task(PlanSink &plan, int start_at, int end_at)
+    {
+        const auto &tasks = this->working_tasks();
+        plan.push_back(Record(tasks.id[this->running_task], start_at, end_at, tasks.priority[this->running_task], this->core));
+    }
+
+    /** how long can the `running_task` run for from `now` */
+    int can_run_for(int now)
+    {
+        return this->working_tasks().duration_left[this->running_task];
+    }
+};
+
+class SchedulerShortestRemainingTimeFirst final : public SchedulerPreemptive<SchedulerShortestRemainingTimeFirst, ReadyQueue<&TaskPool::duration_left>>
+{
+    friend SchedulerPreemptive;
+
+public:
+    SchedulerShortestRemainingTimeFirst(Arrivals &arrivals, EventQueueKind queue_kind) : SchedulerPreemptive(arrivals, queue_kind) {}
+
+protected:
+    int can_run_for(int now)
+    {
+        const auto duration_left = this->working_tasks().duration_left[this->running_task];
+        if (this->arrivals.empty()) {
+            // if nothing will arrive
+            return duration_left;
+        } else {
+            return min(duration_left, this->arrivals.peek().arrive_at - now);
+        }
+    }
+
+    void record_running_task(PlanSink &plan, int start_at, int end_at)
+    {
+        if (!plan.empty() && this->working_tasks().id[this->running_task] == plan.back().id && this->core == plan.back().core) {
+            plan.back().end_at = end_at;
+        } else {
+            SchedulerPreemptive::record_running_task(plan, start_at, end_at);
+        }
+    }
+};
+
+class SchedulerRoundRobin final : public SchedulerPreemptive<SchedulerRoundRobin, FifoQueue>
+{
+    friend SchedulerPreemptive;
+
+public:
+    SchedulerRoundRobin(Arrivals &arrivals, EventQueueKind queue_kind) : SchedulerPreemptive(arrivals, queue_kind) {}
+
+protected:
+    int can_run_for(int now)
+    {
+        const auto &tasks = this->working_tasks();
+        return min(tasks.duration_left[this->running_task], tasks.quantum[this->running_task]);
+    }
+};
+
+/**
+ * @note
+ *
+ * Timeline:
+ *
+ * 1. A task starts running.
+ * 2. Some tasks arrive. (Their priorities -= 1)
+ * 3. The running task is interrupted.
+ * 4. Some other tasks arrives in the meantime. (Their priorites don't change)
+ * 5. We decide what to run next.
+ *
+ * Ideally, We update priorities between 3 and 4.
+ *
+ * But it's impossible: arrive events are handled before the interrupt event.
+ * In other words, 4 will happen before 3. Therefore, we introduce a new event to
+ * increase priorities.
+ */
+class SchedulerDynamicPriority final : public SchedulerPreemptive<SchedulerDynamicPriority, DynamicPriorityQueue>
+{
+    friend SchedulerEngine;
+    friend SchedulerPreemptive;
+
+public:
+    SchedulerDynamicPriority(Arrivals &arrivals, EventQueueKind queue_kind) : SchedulerPreemptive(arrivals, queue_kind) {}
+
+protected:
+    int can_run_for(int now)
+    {
+        const auto &tasks = this->working_tasks();
+        return min(tasks.duration_left[this->running_task], tasks.quantum[this->running_task]);
+    }
+
+    /** Decrease the `running_task`'s priority then record it */
+    void record_running_task(PlanSink &plan, int start_at, int end_at)
+    {
+        this->working_tasks().priority[this->running_task] += 3;
+
+        SchedulerPreemptive::record_running_task(plan, start_at, end_at);
+    }
+
+    void register_event(Event event)
+    {
+        if (event.type == EventType::Complete || event.type == EventType::Interrupt) {
+            // `PrivateUse` goes before any other events at the same moment.
+            SchedulerPreemptive::register_event(Event(EventType::PrivateUse, event.at, NOT_APPLICABLE));
+        }
+
+        SchedulerPreemptive::register_event(event);
+    }
+
+    void handle_event(Event event, PlanSink &plan)
+    {
+        if (event.type == EventType::PrivateUse) {
+            // Increase ready tasks' priorites
+            this->run_queue->queue.age();
+        } else {
+            SchedulerPreemptive::handle_event(event, plan);
+        }
+    }
+};
+
+/**
+ * @brief Multilevel feedback queue
+ *
+ * - A task enters the level of its `priority` (usually 0, the highest), and is recorded with its level as the priority.
+ * - The first task of the highest non-empty level runs for up to that level's quantum. (`Task::quantum` is not used.)
+ * - A task that uses up its slice moves down a level, until the last one.
+ * - Every `boost_interval`, all tasks move back to the highest level.
+ *   The boost is applied at the first decision on or after each multiple of the interval.
+ *
+ * Like `SchedulerRoundRobin`, an arrival does not cut the running slice short.
+ */
+class SchedulerMultilevelFeedbackQueue final : public SchedulerPreemptive<SchedulerMultilevelFeedbackQueue, MultilevelQueue>
+{
+    friend SchedulerEngine;
+    friend SchedulerPreemptive;
+
+protected:
+    MlfqConfig config;
+    /** when the next boost is due */
+    int next_boost_at;
+
+public:
+    SchedulerMultilevelFeedbackQueue(Arrivals &arrivals, EventQueueKind queue_kind, const MlfqConfig &config = MlfqConfig())
+        : SchedulerPreemptive(arrivals, queue_kind), config(config), next_boost_at(config.boost_interval)
+    {
+        this->run_queue->queue.set_n_levels(config.quanta.size());
+    }
+
+protected:
+    void on_interrupt(Event event, PlanSink &plan)
+    {
+        // Put back the running task first, so that a boost lifts it as well.
+        this->handle_last_running_task();
+
+        if (this->config.boost_interval > 0 && event.at >= this->next_boost_at) {
+            this->run_queue->queue.boost();
+            this->next_boost_at = (event.at / this->config.boost_interval + 1) * this->config.boost_interval;
+        }
+
+        SchedulerPreemptive::on_interrupt(event, plan);
+    }
+
+    /** Demote the interrupted task, and put it back */
+    void handle_last_running_task()
+    {
+        if (!this->nothing_running()) {
+            this->working_tasks().priority[this->running_task]++;
+        }
+
+        SchedulerPreemptive::handle_last_running_task();
+    }
+
+    int can_run_for(int now)
+    {
+        const auto &tasks = this->working_tasks();
+        const auto quantum = this->config.quanta[tasks.priority[this->running_task]];
+        return min(tasks.duration_left[this->running_task], quantum);
+    }
+
+    void save_extra(VarintWriter &out) const
+    {
+        out.write(this->next_boost_at);
+    }
+
+    bool load_extra(VarintReader &in)
+    {
+        this->next_boost_at = in.read();
+        return true;
+    }
+};
+
+/**
+ * @brief Completely fair scheduler, in the style of Linux CFS
+ *
+ * - The task with the smallest weighted virtual runtime runs next, see `FairQueue`.
+ * - Its slice is its share of `latency` by weight among runnable tasks (including itself), but at least `min_slice`.
+ *   Therefore slices shrink as more tasks become runnable.
+ * - After running for `t`, its `vruntime` grows by `t × NICE_0_WEIGHT² / weight`, so heavier tasks get more time.
+ *
+ * Like `SchedulerRoundRobin`, an arrival does not cut the running slice short.
+ * A migrated task keeps its `vruntime`, though cores do not share `min_vruntime`.
+ */
+class SchedulerCompletelyFair final : public SchedulerPreemptive<SchedulerCompletelyFair, FairQueue>
+{
+    friend SchedulerEngine;
+    friend SchedulerPreemptive;
+
+protected:
+    CfsConfig config;
+
+public:
+    SchedulerCompletelyFair(Arrivals &arrivals, EventQueueKind queue_kind, const CfsConfig &config = CfsConfig())
+        : SchedulerPreemptive(arrivals, queue_kind), config(config) {}
+
+protected:
+    int can_run_for(int now)
+    {
+        const auto &tasks = this->working_tasks();
+        const auto weight = FairQueue::weight(tasks.priority[this->running_task]);
+        const auto total_weight = weight + this->run_queue->queue.queued_weight();
+
+        const auto slice = max((long long)this->config.min_slice, this->config.latency * weight / total_weight);
+        return (int)min((long long)tasks.duration_left[this->running_task], slice);
+    }
+
+    /** Charge the `running_task`'s virtual runtime then record it */
+    void record_running_task(PlanSink &plan, int start_at, int end_at)
+    {
+        auto &tasks = this->working_tasks();
+        const auto weight = FairQueue::weight(tasks.priority[this->running_task]);
+        tasks.vruntime[this->running_task] += (end_at - start_at) * FairQueue::NICE_0_WEIGHT * FairQueue::NICE_0_WEIGHT / weight;
+
+        SchedulerPreemptive::record_running_task(plan, start_at, end_at);
+    }
+
+    void save_extra(VarintWriter &out) const
+    {
+        out.write(this->run_queue->queue.vruntime_floor());
+    }
+
+    bool load_extra(VarintReader &in)
+    {
+        this->run_queue->queue.set_vruntime_floor(in.read());
+        return true;
+    }
+};
+
+/** 多处理器的就绪队列 */
+enum MultiprocessorMode {
+    /** 每个核一个队列，空闲的核从最忙的核窃取任务 */
+    PerCoreQueues,
+    /** 所有核共用一个队列 */
+    GlobalQueue,
+};
+
+/** The run-time `switch` over algorithms, which only picks the instantiation */
+inline Scheduler *make_scheduler(Algorithm algorithm, Arrivals &arrivals, EventQueueKind queue_kind,
+                                 const AlgorithmConfig &config = AlgorithmConfig())
+{
+    switch (algorithm) {
+    case Algorithm::FirstComeFirstService:
+        return new SchedulerFCFS(arrivals, queue_kind);
+    case Algorithm::ShortestJobFirst:
+        return new SchedulerSJF(arrivals, queue_kind);
+    case Algorithm::ShortestRemainingTimeFirst:
+        return new SchedulerShortestRemainingTimeFirst(arrivals, queue_kind);
+    case Algorithm::RoundRobin:
+        return new SchedulerRoundRobin(arrivals, queue_kind);
+    case Algorithm::DynamicPriority:
+        return new SchedulerDynamicPriority(arrivals, queue_kind);
+    case Algorithm::MultilevelFeedbackQueue:
+        return new SchedulerMultilevelFeedbackQueue(arrivals, queue_kind, config.mlfq);
+    case Algorithm::CompletelyFair:
+        return new SchedulerCompletelyFair(arrivals, queue_kind, config.cfs);
+
+    default:
+        not_implemented();
+        return NULL;
+    }
+}
+
+/**
+ * @brief Schedule a growing trace on a uniprocessor, re-simulating only what the new tasks can change
+ *
+ * Snapshots are taken before batches of arrivals, at least `interval` apart,
+ * and only once as many tasks have arrived since the last one as it would copy.
+ * When tasks are added, `run` resumes from the last snapshot no later than the earliest new arrival,
+ * so the work is proportional to what happens after it rather than the whole trace.
+ *
+ * Each snapshot is a copy of the ready tasks and pending events at that moment,
+ * so a larger `interval` makes the first `run` cheaper but later ones re-simulate more.
+ * For runs in separate processes (e.g. daily), `save` the trace, plan and snapshots after `run`,
+ * then `load` them in the next process and `extend` with the grown trace.
+ * A loaded snapshot is decoded only when `run` resumes from it.
+ * Multiprocessors are not supported.
+ */
+class IncrementalScheduler : protected SnapshotSink
+{
+protected:
+    struct Snapshot {
+        /** when the arrivals it stops before happen */
+        int at;
+        /** the number of records pushed so far */
+        size_t n_records;
+        /** the last record then, which might be extended later */
+        Record last;
+        /** `NULL` until decoded from `saved`, see `load` */
+        unique_ptr<Scheduler> scheduler;
+        vector<uint8_t> saved;
+    };
+
+    Algorithm algorithm;
+    EventQueueKind queue_kind;
+    AlgorithmConfig config;
+    /** the minimum time between snapshots */
+    int interval;
+
+    /** sorted like `read_input` */
+    vector<Task> tasks;
+    ArrivalsFromTasks arrivals;
+    PlanCollector collector;
+    /** in the order of `at` */
+    vector<Snapshot> snapshots;
+
+    /** the earliest arrival among the tasks added since the last `run`, `INT_MAX` if none */
+    int dirty_from;
+    /** when the last `run` resumed from, `NOT_APPLICABLE` if from the beginning */
+    int resumed_at;
+
+public:
+    IncrementalScheduler(Algorithm algorithm, EventQueueKind queue_kind = EventQueueKind::BinaryHeap,
+                         const AlgorithmConfig &config = AlgorithmConfig(), int interval = 100)
+        : algorithm(algorithm), queue_kind(queue_kind), config(config), interval(max(interval, 1)),
+          arrivals(tasks), dirty_from(INT_MIN), resumed_at(NOT_APPLICABLE) {}
+
+    /** Add tasks, arriving at any time. Ids must be new. */
+    void add_tasks(const vector<Task> &tasks)
+    {
+        for (auto &&t : tasks) {
+            this->tasks.push_back(t);
+            this->dirty_from = min(this->dirty_from, t.arrive_at);
+        }
+        sort_tasks(this->tasks);
+    }
+
+    /**
+     * @brief Replace the trace with `tasks`, which should be the trace so far plus new tasks, in any order
+     *
+     * The order of `tasks` is kept among tasks arriving at the same moment with the same priority, as in `read_input`.
+     * Only new tasks can be reordered that way, so the snapshots before them stay valid.
+     *
+     * @return `false` if a task added so far is missing from `tasks` or changed, in which case nothing changes
+     */
+    bool extend(const vector<Task> &tasks)
+    {
+        unordered_map<int, const Task *> known;
+        known.reserve(this->tasks.size());
+        for (auto &&t : this->tasks) {
+            known[t.id] = &t;
+        }
+
+        size_t n_known = 0;
+        int first_new = INT_MAX;
+        for (auto &&t : tasks) {
+            const auto k = known.find(t.id);
+            if (k == known.end()) {
+                first_new = min(first_new, t.arrive_at);
+            } else if (k->second->arrive_at == t.arrive_at && k->second->duration == t.duration &&
+                       k->second->priority == t.priority && k->second->quantum == t.quantum) {
+                n_known++;
+            } else {
+                return false;
+            }
+        }
+        if (n_known != this->tasks.size()) {
+            return false;
+        }
+
+        this->tasks = tasks;
+        sort_tasks(this->tasks);
+        this->dirty_from = min(this->dirty_from, first_new);
+        return true;
+    }
+
+    /** Forget all tasks, the plan and snapshots */
+    void clear()
+    {
+        this->tasks.clear();
+        this->collector.plan.clear();
+        this->snapshots.clear();
+        this->dirty_from = INT_MIN;
+        this->resumed_at = NOT_APPLICABLE;
+    }
+
+    /** Schedule all tasks added so far */
+    const Plan &run()
+    {
+        if (this->dirty_from == INT_MAX) {
+            return this->collector.plan;
+        }
+
+        while (!this->snapshots.empty() && (this->snapshots.back().at > this->dirty_from || !this->decode(this->snapshots.back()))) {
+            this->snapshots.pop_back();
+        }
+
+        unique_ptr<Scheduler> scheduler;
+        auto &plan = this->collector.plan;
+        if (this->snapshots.empty()) {
+            plan.clear();
+            this->arrivals.seek(0);
+            scheduler.reset(make_scheduler(this->algorithm, this->arrivals, this->queue_kind, this->config));
+            scheduler->take_snapshots(this);
+            scheduler->run(this->collector);
+            this->resumed_at = NOT_APPLICABLE;
+        } else {
+            // `snapshots` grows while resuming, so take what is needed first.
+            const auto &snapshot = this->snapshots.back();
+            const int at = snapshot.at;
+            plan.erase(plan.begin() + snapshot.n_records, plan.end());
+            if (!plan.empty()) {
+                plan.back() = snapshot.last;
+            }
+
+            // Tasks before `snapshot.at` have arrived, and the rest have not.
+            this->arrivals.seek(this->n_arrived_before(snapshot.at));
+
+            scheduler.reset(snapshot.scheduler->clone());
+            scheduler->resume(this->collector);
+            this->resumed_at = at;
+        }
+
+        this->dirty_from = INT_MAX;
+        return plan;
+    }
+
+    /** when the last `run` resumed from, `NOT_APPLICABLE` if from the beginning */
+    int last_resumed_at() const
+    {
+        return this->resumed_at;
+    }
+
+    size_t n_snapshots() const
+    {
+        return this->snapshots.size();
+    }
+
+    /**
+     * @brief Write the settings, trace, plan and snapshots, for `load` in another process
+     *
+     * Call after `run`, as tasks added since then would not be scheduled in the plan written.
+     * Snapshots still encoded since `load` are copied as they are.
+     */
+    void save(FILE *file) const
+    {
+        assert(this->dirty_from == INT_MAX);
+
+        VarintWriter out;
+        out.write(INCREMENTAL_STATE_VERSION);
+        this->save_settings(out);
+
+        // Arrivals are sorted, so store the gaps.
+        out.write(this->tasks.size());
+        int last_arrival = 0;
+        for (auto &&t : this->tasks) {
+            for (long long v : {t.id, t.arrive_at - last_arrival, t.duration, t.priority, t.quantum}) {
+                out.write(v);
+            }
+            last_arrival = t.arrive_at;
+        }
+
+        out.write(this->collector.plan.size());
+        int last_end = 0;
+        for (auto &&r : this->collector.plan) {
+            save_record(out, r, last_end);
+            last_end = r.end_at;
+        }
+
+        out.write(this->snapshots.size());
+        VarintWriter state;
+        for (auto &&snapshot : this->snapshots) {
+            out.write(snapshot.at);
+            out.write(snapshot.n_records);
+            save_record(out, snapshot.last, 0);
+
+            const vector<uint8_t> *saved = &snapshot.saved;
+            if (snapshot.scheduler) {
+                state.bytes.clear();
+                snapshot.scheduler->save(state);
+                saved = &state.bytes;
+            }
+            out.write(saved->size());
+            out.write_bytes(saved->data(), saved->size());
+        }
+
+        fwrite(out.bytes.data(), 1, out.bytes.size(), file);
+    }
+
+    /**
+     * @brief Replace everything with what `save` wrote, as if it were `run` here
+     *
+     * Snapshots are kept encoded until `run` resumes from one, as most are never needed again.
+     *
+     * @return `false` if the data is malformed, or saved with other settings (algorithm, event queue, etc.),
+     * in which case everything is cleared
+     */
+    bool load(FILE *file)
+    {
+        this->clear();
+
+        vector<uint8_t> bytes;
+        uint8_t buffer[1 << 16];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            bytes.insert(bytes.end(), buffer, buffer + n);
+        }
+
+        VarintReader in(bytes.data(), bytes.size());
+        const bool ok = in.read() == INCREMENTAL_STATE_VERSION && this->same_settings(in) && this->load_state(in);
+        if (!ok) {
+            this->clear();
+        }
+        return ok;
+    }
+
+protected:
+    static constexpr int INCREMENTAL_STATE_VERSION = 2;
+
+    void save_settings(VarintWriter &out) const
+    {
+        for (long long v : {(int)this->algorithm, (int)this->queue_kind, this->interval}) {
+            out.write(v);
+        }
+        out.write(this->config.mlfq.quanta.size());
+        for (auto &&q : this->config.mlfq.quanta) {
+            out.write(q);
+        }
+        out.write(this->config.mlfq.boost_interval);
+        out.write(this->config.cfs.latency);
+        out.write(this->config.cfs.min_slice);
+    }
+
+    /** Read what `save_settings` writes, and compare with the current ones */
+    bool same_settings(VarintReader &in) const
+    {
+        bool same = in.read() == this->algorithm && in.read() == this->queue_kind && in.read() == this->interval;
+
+        const auto &quanta = this->config.mlfq.quanta;
+        same = same && in.read() == (int64_t)quanta.size();
+        for (size_t i = 0; i < quanta.size() && same; i++) {
+            same = in.read() == quanta[i];
+        }
+        same = same && in.read() == this->config.mlfq.boost_interval;
+
+        same = same && in.read() == this->config.cfs.latency && in.read() == this->config.cfs.min_slice;
+        return same && in.ok();
+    }
+
+    /** Times are stored relative to `last_end`, the end of the record before */
+    static void save_record(VarintWriter &out, const Record &r, int last_end)
+    {
+        for (long long v : {r.id, r.start_at - last_end, r.end_at - r.start_at, r.priority, r.core}) {
+            out.write(v);
+        }
+    }
+
+    static Record load_record(VarintReader &in, int last_end)
+    {
+        Record r(0, 0, 0, 0);
+        r.id = in.read();
+        r.start_at = last_end + in.read();
+        r.end_at = r.start_at + in.read();
+        r.priority = in.read();
+        r.core = in.read();
+        return r;
+    }
+
+    /** Read what `save` writes after the settings */
+    bool load_state(VarintReader &in)
+    {
+        const int64_t n_tasks = in.read();
+        int last_arrival = 0;
+        for (int64_t i = 0; i < n_tasks && in.ok(); i++) {
+            Task t;
+            t.id = in.read();
+            t.arrive_at = last_arrival + in.read();
+            t.duration = in.read();
+            t.priority = in.read();
+            t.quantum = in.read();
+            this->tasks.push_back(t);
+            last_arrival = t.arrive_at;
+        }
+
+        auto &plan = this->collector.plan;
+        const int64_t n_records = in.read();
+        for (int64_t i = 0; i < n_records && in.ok(); i++) {
+            plan.push_back(load_record(in, plan.empty() ? 0 : plan.back().end_at));
+        }
+
+        const int64_t n_snapshots = in.read();
+        for (int64_t i = 0; i < n_snapshots && in.ok(); i++) {
+            const int at = in.read();
+            const int64_t n_records = in.read();
+            const auto last = load_record(in, 0);
+            const int64_t n_bytes = in.read();
+            const uint8_t *saved = n_bytes >= 0 ? in.read_bytes(n_bytes) : NULL;
+            if (saved == NULL || n_records < 0 || (uint64_t)n_records > plan.size()) {
+                return false;
+            }
+
+            this->snapshots.push_back(Snapshot{at, (size_t)n_records, last, nullptr, vector<uint8_t>(saved, saved + n_bytes)});
+        }
+
+        this->dirty_from = INT_MAX;
+        return in.ok() && in.at_end();
+    }
+
+    /**
+     * @brief Make `snapshot.scheduler` from `snapshot.saved` if not yet
+     *
+     * @return `false` if `saved` is malformed
+     */
+    bool decode(Snapshot &snapshot)
+    {
+        if (snapshot.scheduler) {
+            return true;
+        }
+
+        unique_ptr<Scheduler> scheduler(make_scheduler(this->algorithm, this->arrivals, this->queue_kind, this->config));
+        VarintReader in(snapshot.saved.data(), snapshot.saved.size());
+        if (!scheduler->load(in) || !in.at_end()) {
+            return false;
+        }
+        scheduler->take_snapshots(this);
+        snapshot.scheduler = move(scheduler);
+        snapshot.saved.clear();
+        snapshot.saved.shrink_to_fit();
+        return true;
+    }
+
+    bool wants_snapshot(int at, size_t n_tasks)
+    {
+        if (this->snapshots.empty()) {
+            return true;
+        }
+
+        // Copy no more tasks than have arrived since the last snapshot,
+        // so that all snapshots together stay about as large as the trace even when tasks pile up.
+        const int last_at = this->snapshots.back().at;
+        return at - last_at >= this->interval && this->n_arrived_before(at) - this->n_arrived_before(last_at) >= n_tasks;
+    }
+
+    /** the number of tasks arriving before `at` */
+    size_t n_arrived_before(int at) const
+    {
+        return lower_bound(this->tasks.begin(), this->tasks.end(), at, [](const Task &t, int at) {
+                   return t.arrive_at < at;
+               }) -
+               this->tasks.begin();
+    }
+
+    void save_snapshot(int at, Scheduler *snapshot)
+    {
+        const auto &plan = this->collector.plan;
+        this->snapshots.push_back(Snapshot{at, plan.size(), plan.empty() ? Record(0, 0, 0, 0) : plan.back(), unique_ptr<Scheduler>(snapshot), {}});
+    }
+};
+
+/** Run-time interface of `MultiprocessorEngine` */
+class MultiprocessorRunner
+{
+public:
+    virtual ~MultiprocessorRunner() {}
+
+    virtual void run(PlanSink &plan, bool report_usage) = 0;
+};
+
+/**
+ * @brief Schedule on several cores, each by an `S` such as `SchedulerRoundRobin`
+ *
+ * All cores share one event queue, and every event is handled by the core it happens on.
+ *
+ * - `PerCoreQueues`: An arriving task goes to the core with the fewest tasks.
+ *   Whenever a core is idle, it steals the next ready task from the core with the most ready tasks.
+ * - `GlobalQueue`: All cores share one run queue, and an arriving task wakes an idle core if any.
+ */
+template <typename S>
+class MultiprocessorEngine : public MultiprocessorRunner
+{
+protected:
+    Arrivals &arrivals;
+    MultiprocessorMode mode;
+    vector<unique_ptr<S>> cores;
+
+    /** the number of tasks stolen by idle cores */
+    long long n_steals;
+
+public:
+    /** `args` are passed on to the constructor of `S` */
+    template <typename... Args>
+    MultiprocessorEngine(Arrivals &arrivals, EventQueueKind queue_kind, int n_cores, MultiprocessorMode mode, const Args &...args)
+        : arrivals(arrivals), mode(mode), n_steals(0)
+    {
+        assert(n_cores > 0);
+
+        for (int c = 0; c < n_cores; c++) {
+            this->cores.emplace_back(new S(arrivals, queue_kind, args...));
+            if (c > 0) {
+                this->cores[c]->join(*this->cores[0], c, mode == MultiprocessorMode::GlobalQueue);
+            }
+        }
+    }
+
+    /** Run, push records to `plan`, and report the usage of each core to `stderr` if `report_usage` */
+    void run(PlanSink &plan, bool report_usage)
+    {
+        PlanSinkUsage usage(plan, this->cores.size());
+        auto &events = this->cores[0]->event_queue();
+
+        int n_arrived = 0;
+        this->register_next_arrival();
+
+        while (!events.empty()) {
+            auto event = events.pop();
+            if (event.type == EventType::Arrive) {
+                // Admit every task arriving now, then let each idle core decide once.
+                do {
+                    const auto task = this->arrivals.peek();
+                    this->arrivals.pop();
+
+                    this->cores[this->place(task)]->admit(Event(EventType::Arrive, event.at, task.id), task, n_arrived, usage);
+                    n_arrived++;
+                } while (!this->arrivals.empty() && this->arrivals.peek().arrive_at == event.at);
+                this->register_next_arrival();
+
+                for (auto &&core : this->cores) {
+                    core->wake(event, usage);
+                }
+            } else {
+                this->cores[event.core]->handle(event, usage);
+            }
+
+            if (this->mode == MultiprocessorMode::PerCoreQueues) {
+                this->balance(event.at, usage);
+            }
+
+            ENGINE_STATS(sample(event.at, this->n_ready(), events.size()));
+        }
+
+        usage.finish();
+        if (report_usage) {
+            this->report(usage);
+        }
+    }
+
+protected:
+    void register_next_arrival()
+    {
+        if (!this->arrivals.empty()) {
+            const auto &t = this->arrivals.peek();
+            this->cores[0]->event_queue().push(Event(EventType::Arrive, t.arrive_at, t.id));
+        }
+    }
+
+    /** the number of ready tasks on all cores */
+    size_t n_ready() const
+    {
+        if (this->mode == MultiprocessorMode::GlobalQueue) {
+            return this->cores[0]->n_ready();
+        }
+
+        size_t n = 0;
+        for (auto &&core : this->cores) {
+            n += core->n_ready();
+        }
+        return n;
+    }
+
+    /** Choose a core for an arriving task */
+    int place(const Task &task)
+    {
+        const int n_cores = this->cores.size();
+
+        if (this->mode == MultiprocessorMode::GlobalQueue) {
+            for (int c = 0; c < n_cores; c++) {
+                if (this->cores[c]->nothing_running()) {
+                    return c;
+                }
+            }
+            return 0;
+        }
+
+        int best = 0;
+        for (int c = 1; c < n_cores; c++) {
+            if (this->cores[c]->n_tasks() < this->cores[best]->n_tasks()) {
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    /** Let idle cores steal from the core with the most ready tasks */
+    void balance(int now, PlanSink &plan)
+    {
+        const int n_cores = this->cores.size();
+
+        for (int thief = 0; thief < n_cores; thief++) {
+            if (!this->cores[thief]->idle()) {
+                continue;
+            }
+
+            int victim = NOT_APPLICABLE;
+            for (int c = 0; c < n_cores; c++) {
+                if (this->cores[c]->n_ready() > 0 &&
+                    (victim == NOT_APPLICABLE || this->cores[c]->n_ready() > this->cores[victim]->n_ready())) {
+                    victim = c;
+                }
+            }
+            if (victim == NOT_APPLICABLE) {
+                return;
+            }
+
+            this->cores[victim]->migrate_to(*this->cores[thief], now, plan);
+            this->n_steals++;
+        }
+    }
+
+    void report(const PlanSinkUsage &usage)
+    {
+        long long n_migrations = 0;
+
+        for (size_t c = 0; c < this->cores.size(); c++) {
+            const auto &u = usage.cores[c];
+            const auto migrations = this->cores[c]->migrations();
+            n_migrations += migrations;
+
+            fprintf(stderr, "core %zu: utilisation %.2f%%, %lld slices, %lld migrations in\n",
+                    c,
+                    usage.makespan > 0 ? 100.0 * u.busy / usage.makespan : 0.0,
+                    u.n_slices, migrations);
+        }
+
+        fprintf(stderr, "total: makespan %d, %lld steals, %lld migrations\n",
+                usage.makespan, this->n_steals, n_migrations);
+    }
+};
+
+/**
+ * @brief Schedule on several cores, each by a scheduler of the same algorithm
+ *
+ * See `MultiprocessorEngine`, whose instantiation is picked by the algorithm.
+ */
+class MultiprocessorScheduler
+{
+protected:
+    unique_ptr<MultiprocessorRunner> engine;
+
+public:
+    MultiprocessorScheduler(Algorithm algorithm, Arrivals &arrivals, EventQueueKind queue_kind, int n_cores, MultiprocessorMode mode,
+                            const AlgorithmConfig &config = AlgorithmConfig())
+    {
+        switch (algorithm) {
+        case Algorithm::FirstComeFirstService:
+            this->engine.reset(new MultiprocessorEngine<SchedulerFCFS>(arrivals, queue_kind, n_cores, mode));
+            break;
+        case Algorithm::ShortestJobFirst:
+            this->engine.reset(new MultiprocessorEngine<SchedulerSJF>(arrivals, queue_kind, n_cores, mode));
+            break;
+        case Algorithm::ShortestRemainingTimeFirst:
+            this->engine.reset(new MultiprocessorEngine<SchedulerShortestRemainingTimeFirst>(arrivals, queue_kind, n_cores, mode));
+            break;
+        case Algorithm::RoundRobin:
+            this->engine.reset(new MultiprocessorEngine<SchedulerRoundRobin>(arrivals, queue_kind, n_cores, mode));
+            break;
+        case Algorithm::DynamicPriority:
+            this->engine.reset(new MultiprocessorEngine<SchedulerDynamicPriority>(arrivals, queue_kind, n_cores, mode));
+            break;
+        case Algorithm::MultilevelFeedbackQueue:
+            this->engine.reset(new MultiprocessorEngine<SchedulerMultilevelFeedbackQueue>(arrivals, queue_kind, n_cores, mode, config.mlfq));
+            break;
+        case Algorithm::CompletelyFair:
+            this->engine.reset(new MultiprocessorEngine<SchedulerCompletelyFair>(arrivals, queue_kind, n_cores, mode, config.cfs));
+            break;
+
+        default:
+            not_implemented();
+        }
+    }
+
+    /** Run, push records to `plan`, and report the usage of each core to `stderr` if `report_usage` */
+    void run(PlanSink &plan, bool report_usage = true)
+    {
+        this->engine->run(plan, report_usage);
+    }
+};
@@ -0,0 +1,197 @@
+#include <new>
+#include <stdio.h>
+
+#include "scheduler.hpp"
+#include "scheduler_api.h"
+
+using namespace std;
+
+struct sched_input {
+    Input input;
+    /** whether `input.tasks` is sorted by `sort_tasks` */
+    bool sorted;
+};
+
+struct sched_result {
+    vector<sched_record> records;
+};
+
+/** Collect records as `sched_record`s */
+class PlanSinkApi : public PlanSink
+{
+protected:
+    vector<sched_record> &records;
+    /** the last record, in the form of `PlanSink` */
+    Record last;
+
+public:
+    PlanSinkApi(vector<sched_record> &records) : records(records), last(0, 0, 0, 0) {}
+
+    void push_back(Record record)
+    {
+        this->flush();
+        this->last = record;
+        this->records.push_back(sched_record());
+    }
+
+    bool empty() const
+    {
+        return this->records.empty();
+    }
+
+    Record &back()
+    {
+        assert(!this->empty());
+        return this->last;
+    }
+
+    void finish()
+    {
+        this->flush();
+    }
+
+protected:
+    /** Copy `last` to the last `sched_record` */
+    void flush()
+    {
+        if (!this->empty()) {
+            const auto &r = this->last;
+            this->records.back() = sched_record{r.id, r.start_at, r.end_at, r.priority, r.core};
+        }
+    }
+};
+
+static bool is_algorithm(int algorithm)
+{
+    return Algorithm::FirstComeFirstService <= algorithm && algorithm <= Algorithm::CompletelyFair;
+}
+
+/** Whether `task` can be scheduled by `algorithm` without running forever */
+static bool is_valid_task(Algorithm algorithm, const Task &task)
+{
+    const bool uses_quantum = algorithm == Algorithm::RoundRobin || algorithm == Algorithm::DynamicPriority;
+    return task.duration >= 0 && (!uses_quantum || task.quantum > 0);
+}
+
+int sched_api_version(void)
+{
+    return SCHED_API_VERSION;
+}
+
+sched_input *sched_input_new(int algorithm)
+{
+    if (!is_algorithm(algorithm)) {
+        return NULL;
+    }
+
+    auto input = new (nothrow) sched_input();
+    if (input != NULL) {
+        input->input.algorithm = (Algorithm)algorithm;
+        input->sorted = true;
+    }
+    return input;
+}
+
+int sched_input_add_task(sched_input *input, int id, int arrive_at, int duration, int priority, int quantum)
+{
+    const Task task{id, arrive_at, duration, priority, quantum};
+    if (input == NULL || !is_valid_task(input->input.algorithm, task)) {
+        return -1;
+    }
+
+    try {
+        input->input.tasks.push_back(task);
+    } catch (const bad_alloc &) {
+        return -1;
+    }
+    input->sorted = false;
+    return 0;
+}
+
+sched_input *sched_input_parse(const char *text, size_t length)
+{
+    if (length == 0) {
+        return NULL;
+    }
+    FILE *file = fmemopen((void *)text, length, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    sched_input *input = NULL;
+    try {
+        InputParser parser(file);
+        const int algorithm = parser.read_int();
+        if (parser.ok() && is_algorithm(algorithm)) {
+            TaskReaderText reader(parser);
+            auto parsed = read_input((Algorithm)algorithm, reader);
+            const bool valid = all_of(parsed.tasks.begin(), parsed.tasks.end(), [&](const Task &t) {
+                return is_valid_task(parsed.algorithm, t);
+            });
+            if (parser.ok() && valid) {
+                input = new sched_input{move(parsed), true};
+            }
+        }
+    } catch (const bad_alloc &) {
+        input = NULL;
+    }
+
+    fclose(file);
+    return input;
+}
+
+void sched_input_free(sched_input *input)
+{
+    delete input;
+}
+
+sched_result *sched_run(const sched_input *input, int event_queue, int n_cores, int smp)
+{
+    if (input == NULL || n_cores < 0 ||
+        (event_queue != SCHED_EVENT_QUEUE_HEAP && event_queue != SCHED_EVENT_QUEUE_CALENDAR) ||
+        (smp != SCHED_SMP_PER_CORE && smp != SCHED_SMP_GLOBAL)) {
+        return NULL;
+    }
+
+    try {
+        // Sort a copy, so that runs of the same input can share it.
+        const vector<Task> *tasks = &input->input.tasks;
+        vector<Task> sorted_tasks;
+        if (!input->sorted) {
+            sorted_tasks = *tasks;
+            sort_tasks(sorted_tasks);
+            tasks = &sorted_tasks;
+        }
+
+        unique_ptr<sched_result> result(new sched_result());
+        PlanSinkApi plan(result->records);
+        ArrivalsFromTasks arrivals(*tasks);
+        const auto queue_kind = event_queue == SCHED_EVENT_QUEUE_CALENDAR ? EventQueueKind::Calendar : EventQueueKind::BinaryHeap;
+
+        if (n_cores > 0) {
+            const auto mode = smp == SCHED_SMP_GLOBAL ? MultiprocessorMode::GlobalQueue : MultiprocessorMode::PerCoreQueues;
+            MultiprocessorScheduler scheduler(input->input.algorithm, arrivals, queue_kind, n_cores, mode);
+            scheduler.run(plan, false);
+        } else {
+            unique_ptr<Scheduler> scheduler(make_scheduler(input->input.algorithm, arrivals, queue_kind));
+            scheduler->run(plan);
+        }
+
+        return result.release();
+    } catch (const bad_alloc &) {
+        return NULL;
+    }
+}
+
+const sched_record *sched_result_records(const sched_result *result, size_t *n_records)
+{
+    if (n_records != NULL) {
+        *n_records = result != NULL ? result->records.size() : 0;
+    }
+    return result != NULL ? result->records.data() : NULL;
+}
+
+void sched_result_free(sched_result *result)
+{
+    delete result;
+}
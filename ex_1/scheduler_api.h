@@ -0,0 +1,94 @@
+#pragma once
+
+/**
+ * @file
+ * @brief A C interface to the schedulers in `scheduler.hpp`, for running many simulations in one process
+ *
+ * Build it as a shared library:
+ *
+ * ```shell
+ * g++ -std=c++17 -O2 -shared -fPIC -o libscheduler.so scheduler_api.cpp
+ * ```
+ *
+ * Usage: build an input (`sched_input_new` + `sched_input_add_task`, or `sched_input_parse`),
+ * `sched_run` it as many times as needed, and read the records of each result.
+ *
+ * Functions returning pointers return `NULL` on invalid arguments or allocation failures,
+ * and functions returning `int` return 0 on success and -1 on those failures.
+ * There is no global state, so different inputs and results can be used from different threads,
+ * and one input can be run from several threads at once, as long as no task is being added to it.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Increased whenever the interface changes incompatibly */
+#define SCHED_API_VERSION 2
+
+/** Algorithms, the same as the first line of the text input */
+enum {
+    SCHED_FIRST_COME_FIRST_SERVICE = 1,
+    SCHED_SHORTEST_JOB_FIRST = 2,
+    SCHED_SHORTEST_REMAINING_TIME_FIRST = 3,
+    SCHED_ROUND_ROBIN = 4,
+    SCHED_DYNAMIC_PRIORITY = 5,
+    /** with the default levels of `MlfqConfig` in `scheduler.hpp` */
+    SCHED_MULTILEVEL_FEEDBACK_QUEUE = 6,
+    /** with the default `CfsConfig` in `scheduler.hpp` */
+    SCHED_COMPLETELY_FAIR = 7,
+};
+
+enum {
+    SCHED_EVENT_QUEUE_HEAP = 0,
+    SCHED_EVENT_QUEUE_CALENDAR = 1,
+};
+
+/** Run queues on multiprocessors */
+enum {
+    SCHED_SMP_PER_CORE = 0,
+    SCHED_SMP_GLOBAL = 1,
+};
+
+typedef struct sched_input sched_input;
+typedef struct sched_result sched_result;
+
+typedef struct sched_record {
+    int id;
+    int start_at;
+    int end_at;
+    int priority;
+    /** always 0 on a uniprocessor */
+    int core;
+} sched_record;
+
+/** `SCHED_API_VERSION` of the library, to be compared with the header's */
+int sched_api_version(void);
+
+sched_input *sched_input_new(int algorithm);
+/**
+ * Tasks can be added in any order, but ids must be unique.
+ * A negative `duration` is invalid, and so is a `quantum` not above 0 for round robin and dynamic priority.
+ */
+int sched_input_add_task(sched_input *input, int id, int arrive_at, int duration, int priority, int quantum);
+/** Parse the text format (`text` need not end with `\0`), `NULL` if it is malformed or has invalid tasks */
+sched_input *sched_input_parse(const char *text, size_t length);
+void sched_input_free(sched_input *input);
+
+/**
+ * @brief Schedule `input`
+ *
+ * @param event_queue `SCHED_EVENT_QUEUE_*`
+ * @param n_cores 0 for the uniprocessor scheduler
+ * @param smp `SCHED_SMP_*`, ignored on a uniprocessor
+ */
+sched_result *sched_run(const sched_input *input, int event_queue, int n_cores, int smp);
+/** the records, in the order they are printed, and their number in `*n_records` (`NULL` and 0 if `result` is `NULL`) */
+const sched_record *sched_result_records(const sched_result *result, size_t *n_records);
+void sched_result_free(sched_result *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @file
+ * @brief Zigzag LEB128 varints, shared by `binary_trace.hpp`, `CompactPlan` and the state of `IncrementalScheduler`
+ *
+ * Signed values are zigzag-encoded first (0, -1, 1, -2, … become 0, 1, 2, 3, …), so small magnitudes take one byte.
+ */
+
+inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/** Append `v` to `bytes` as a LEB128 varint */
+inline void append_varint(std::vector<uint8_t> &bytes, uint64_t v)
+{
+    do {
+        bytes.push_back((v & 0x7f) | (v >= 0x80 ? 0x80 : 0));
+        v >>= 7;
+    } while (v != 0);
+}
+
+/**
+ * @brief Decode a LEB128 varint at `data[pos]`, and advance `pos` past it
+ *
+ * @return `false` if the data ends within the varint, or it is longer than 64 bits
+ */
+inline bool decode_varint(const uint8_t *data, size_t size, size_t &pos, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < size; shift += 7) {
+        const auto byte = data[pos++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Integers as zigzag varints in memory, for state that is not a table of rows
+ *
+ * Unlike rows of a trace, values are not stored as differences, and nothing is written to a file until asked.
+ */
+class VarintWriter
+{
+public:
+    std::vector<uint8_t> bytes;
+
+    void write(int64_t v)
+    {
+        append_varint(this->bytes, zigzag(v));
+    }
+
+    /** Append `n` bytes as they are */
+    void write_bytes(const uint8_t *data, size_t n)
+    {
+        this->bytes.insert(this->bytes.end(), data, data + n);
+    }
+};
+
+/** Reads integers written by `VarintWriter` */
+class VarintReader
+{
+protected:
+    const uint8_t *data;
+    size_t size;
+    /** the next byte in `data` */
+    size_t pos;
+    bool valid;
+
+public:
+    VarintReader(const uint8_t *data, size_t size) : data(data), size(size), pos(0), valid(true) {}
+
+    /** Whether nothing read so far is truncated */
+    bool ok() const
+    {
+        return this->valid;
+    }
+
+    bool at_end() const
+    {
+        return this->pos == this->size;
+    }
+
+    /** @return 0 if truncated, in which case `ok()` becomes `false` */
+    int64_t read()
+    {
+        uint64_t v;
+        if (!this->valid || !decode_varint(this->data, this->size, this->pos, v)) {
+            this->valid = false;
+            return 0;
+        }
+        return unzigzag(v);
+    }
+
+    /** Take the next `n` bytes as they are, `NULL` if fewer are left */
+    const uint8_t *read_bytes(size_t n)
+    {
+        if (!this->valid || n > this->size - this->pos) {
+            this->valid = false;
+            return NULL;
+        }
+        this->pos += n;
+        return this->data + this->pos - n;
+    }
+};
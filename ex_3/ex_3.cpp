@@ -1,10 +1,12 @@
 #include <assert.h>
 #include <iostream>
-#include <list>
 #include <signal.h>
 #include <sstream>
+#include <string.h>
 #include <vector>
 
+#include "manager.hpp"
+
 using namespace std;
 
 void not_implemented()
@@ -13,12 +15,38 @@ void not_implemented()
     raise(SIGFPE);
 }
 
-enum Policy {
-    Optimal = 1,
-    FirstInFirstOut = 2,
-    LeastRecentlyUsed = 3,
+/** 命令行选项 */
+struct Options {
+    /** Print each change as soon as it is made, without keeping them */
+    bool stream = false;
+    /** Print `frame,old,new,hit` for each change instead of the whole page table. Implies `stream`. */
+    bool delta = false;
 };
 
+void print_usage(const char *program)
+{
+    cerr << "Usage: " << program << " [--stream] [--delta] < input" << endl;
+}
+
+Options parse_args(int argc, char *argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stream") == 0) {
+            options.stream = true;
+        } else if (strcmp(argv[i], "--delta") == 0) {
+            options.stream = true;
+            options.delta = true;
+        } else {
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return options;
+}
+
 struct Input {
     Policy policy;
     unsigned int n_frames;
@@ -45,18 +73,14 @@ Input read_inputs()
     return input;
 }
 
-#define IDLE -1
-/// 页表，数字表示物理页框号，`IDLE`表示空闲
-using PageTable = vector<int>;
-using Page = PageTable::iterator;
-using Request = vector<int>::const_iterator;
-
-struct PageChange {
-    PageTable table;
-    bool hit;
-
-    PageChange(PageTable table, bool hit) : table(table), hit(hit) {}
-};
+void print_page(int page)
+{
+    if (page == IDLE) {
+        cout << "-";
+    } else {
+        cout << page;
+    }
+}
 
 void write_outputs(vector<PageChange> changes)
 {
@@ -73,12 +97,7 @@ void write_outputs(vector<PageChange> changes)
 
         // 2. page table
         for (auto &&i : c.table) {
-            if (i == IDLE) {
-                cout << "-";
-            } else {
-                cout << i;
-            }
-
+            print_page(i);
             cout << ",";
         }
 
@@ -93,210 +112,84 @@ void write_outputs(vector<PageChange> changes)
          << n_page_faults << endl;
 }
 
-class Manager
+/**
+ * @brief Print changes like `write_outputs` as soon as they are made
+ *
+ * Page faults are counted on the fly, so memory does not grow with the number of requests.
+ */
+class ChangePrinter : public ChangeSink
 {
 protected:
-    PageTable table;
+    /** see `Options::delta` */
+    bool delta;
+    size_t n_requests;
+    size_t n_page_faults;
 
 public:
-    Manager(unsigned int n_frames) : table(PageTable(n_frames, IDLE)) {}
-
-    vector<PageChange> request(const vector<int> &requests)
-    {
-        vector<PageChange> changes;
-
-        const auto request_begin = requests.begin(),
-                   request_end = requests.end();
-        for (auto r = requests.begin(); r != request_end; ++r) {
-            const bool hit = this->can_hit(*r);
-
-            if (!hit) {
-                // Find where to insert / swap
-                auto where = this->find_idle();
-                if (where == this->table.end()) {
-                    where = this->next_to_swap(r, request_begin, request_end);
-                }
-
-                // insert / swap
-                this->swap(where, *r);
-            }
+    ChangePrinter(bool delta) : delta(delta), n_requests(0), n_page_faults(0) {}
 
-            changes.push_back(PageChange(this->table, hit));
-        }
-
-        return changes;
-    }
-
-    virtual ~Manager() {}
-
-protected:
-    virtual void swap(Page where, int frame)
+    void push(const PageTable &table, size_t frame, int old_page, bool hit)
     {
-        *where = frame;
-    }
-
-    /**
-     * @brief Find an idle page in the page table
-     *
-     * @return PageTable::iterator `end` if none
-     */
-    Page find_idle()
-    {
-        const auto end = this->table.end();
-
-        auto p = this->table.begin();
-        while (p != end && *p != IDLE) {
-            ++p;
+        // 1. separator
+        if (this->n_requests > 0) {
+            cout << "/";
         }
-        return p;
-    }
-
-    virtual Page next_to_swap(const Request &current_request, const Request begin, const Request end) = 0;
 
-    bool can_hit(int request)
-    {
-        for (auto &&p : this->table) {
-            if (p == request) {
-                return true;
+        // 2. page table or its change
+        if (this->delta) {
+            cout << frame << ",";
+            print_page(old_page);
+            cout << ",";
+            print_page(table[frame]);
+            cout << ",";
+        } else {
+            for (auto &&i : table) {
+                print_page(i);
+                cout << ",";
             }
         }
-        return false;
-    }
-};
-
-class ManagerFIFO : public Manager
-{
-protected:
-    list<Page> history;
-
-public:
-    ManagerFIFO(unsigned int n_frames) : Manager(n_frames) {}
-
-protected:
-    virtual Page next_to_swap(const Request &current_request, const Request begin, const Request end)
-    {
-        return this->history.front();
-    }
-
-    virtual void swap(Page where, int frame)
-    {
-        if (*where != IDLE) {
-            this->history.remove(where);
-        }
-
-        Manager::swap(where, frame);
-        this->history.push_back(where);
-    }
-};
-
-class ManagerOptimal : public ManagerFIFO
-{
-
-public:
-    ManagerOptimal(unsigned int n_frames) : ManagerFIFO(n_frames) {}
 
-protected:
-    Page next_to_swap(const Request &current_request, const Request begin, const Request end)
-    {
-        Page best_page = this->history.front();
-        auto best_rounds = this->when_next_request(*best_page, current_request, end);
-
-        for (auto &&p : this->history) {
-            auto r = this->when_next_request(*p, current_request, end);
-
-            if (r > best_rounds) {
-                best_page = p;
-                best_rounds = r;
-            }
-        }
+        // 3. hit or miss
+        cout << (hit ? "1" : "0");
 
-        return best_page;
+        // 4. count page faults
+        this->n_requests++;
+        this->n_page_faults += !hit;
     }
 
-    /**
-     * @brief when the next same page will be requested
-     *
-     * @return 到那时的轮数（若再未申请，则是到结尾的轮数）
-     */
-    size_t when_next_request(int page, const Request &current_request, const Request end)
+    /** Print the number of page faults, and the fault rate to `stderr` */
+    void finish()
     {
-        size_t round = 0;
+        cout << "\n"
+             << this->n_page_faults << endl;
 
-        auto r = current_request;
-        while (r != end && *r != page) {
-            round++;
-            ++r;
+        if (this->n_requests > 0) {
+            cerr << "fault rate: " << this->n_page_faults << "/" << this->n_requests
+                 << " = " << 100.0 * this->n_page_faults / this->n_requests << "%" << endl;
         }
-        return round;
     }
 };
 
-class ManagerLeastRecentlyUsed : public Manager
+int main(int argc, char *argv[])
 {
-public:
-    ManagerLeastRecentlyUsed(unsigned int n_frames) : Manager(n_frames) {}
-
-protected:
-    Page next_to_swap(const Request &current_request, const Request begin, const Request end)
-    {
-        Page best_page = this->table.begin();
-        auto best_rounds = this->when_prev_request(*best_page, current_request, begin);
-
-        const auto table_end = this->table.end();
-        for (auto p = this->table.begin(); p != table_end; ++p) {
-            auto r = this->when_prev_request(*p, current_request, begin);
-
-            if (r > best_rounds) {
-                best_page = p;
-                best_rounds = r;
-            }
-        }
+    // Before any I/O. Only iostreams are used, so they need not stay in sync with C stdio.
+    ios::sync_with_stdio(false);
 
-        return best_page;
-    }
-
-    /**
-     * @brief when the last same page was requested
-     *
-     * @return 自那时的轮数（若再未申请，则是到开头的轮数）
-     */
-    size_t when_prev_request(int page, const Request &current_request, const Request begin)
-    {
-        const auto rbegin = prev(begin);
-
-        size_t round = 0;
-
-        auto r = current_request;
-        while (r != rbegin && *r != page) {
-            round++;
-            --r;
-        }
-        return round;
-    }
-};
-
-int main()
-{
+    const auto options = parse_args(argc, argv);
     auto input = read_inputs();
 
-    Manager *manager = nullptr;
-    switch (input.policy) {
-    case Policy::FirstInFirstOut:
-        manager = new ManagerFIFO(input.n_frames);
-        break;
-    case Policy::Optimal:
-        manager = new ManagerOptimal(input.n_frames);
-        break;
-    case Policy::LeastRecentlyUsed:
-        manager = new ManagerLeastRecentlyUsed(input.n_frames);
-        break;
-
-    default:
+    Manager *manager = make_manager(input.policy, input.n_frames);
+    if (manager == nullptr) {
         not_implemented();
-        break;
     }
 
-    write_outputs(manager->request(input.pages));
+    if (options.stream) {
+        ChangePrinter printer(options.delta);
+        manager->request(input.pages, printer);
+        printer.finish();
+    } else {
+        write_outputs(manager->request(input.pages));
+    }
     delete manager;
 
     return 0;
@@ -0,0 +1,504 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Page managers, shared by `ex_3.cpp` and `paging_api.cpp`
+ */
+
+#include <algorithm>
+#include <assert.h>
+#include <queue>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+enum Policy {
+    Optimal = 1,
+    FirstInFirstOut = 2,
+    LeastRecentlyUsed = 3,
+};
+
+#define IDLE -1
+/// 页表，数字表示物理页框号，`IDLE`表示空闲
+using PageTable = vector<int>;
+using Page = PageTable::iterator;
+using Request = vector<int>::const_iterator;
+
+struct PageChange {
+    PageTable table;
+    bool hit;
+
+    PageChange(PageTable table, bool hit) : table(table), hit(hit) {}
+};
+
+/** Where the result of each request goes */
+class ChangeSink
+{
+public:
+    virtual ~ChangeSink() {}
+
+    /**
+     * @brief Called after each request
+     *
+     * @param table the page table after the request, only valid during the call
+     * @param frame the index of the frame hit or swapped in `table`
+     * @param old_page the page in `frame` before the request, `IDLE` if it was idle
+     */
+    virtual void push(const PageTable &table, size_t frame, int old_page, bool hit) = 0;
+};
+
+/** Collect a copy of the page table after each request */
+class ChangeCollector : public ChangeSink
+{
+public:
+    vector<PageChange> changes;
+
+    void push(const PageTable &table, size_t frame, int old_page, bool hit)
+    {
+        this->changes.push_back(PageChange(table, hit));
+    }
+};
+
+/**
+ * @brief Serves requests with a page table, and leaves the choice of the victim to subclasses
+ *
+ * Resident pages are indexed by `residents`, and idle frames are kept in `idle_frames`,
+ * so checking a hit and finding an idle frame are O(1) regardless of the number of frames.
+ * Tables of at most `SMALL_TABLE` frames are scanned instead, which compiles to a few SIMD compares and beats hashing.
+ */
+class Manager
+{
+protected:
+    PageTable table;
+    /** page → its index in `table`, not maintained for small tables */
+    unordered_map<int, size_t> residents;
+    /** indices of idle frames in `table`, the first on the top */
+    vector<size_t> idle_frames;
+    /** the index of the request being served by `request` */
+    size_t now;
+
+public:
+    static constexpr size_t SMALL_TABLE = 16;
+
+protected:
+    /** a copy of a small `table`, padded with `IDLE` to a fixed length for SIMD */
+    int small_table[SMALL_TABLE];
+
+public:
+    Manager(unsigned int n_frames) : table(PageTable(n_frames, IDLE)), now(0)
+    {
+        for (size_t i = n_frames; i-- > 0;) {
+            this->idle_frames.push_back(i);
+        }
+        fill(begin(this->small_table), end(this->small_table), IDLE);
+        if (!this->is_small()) {
+            this->residents.reserve(n_frames);
+        }
+    }
+
+    vector<PageChange> request(const vector<int> &requests)
+    {
+        ChangeCollector collector;
+        this->request(requests, collector);
+        return move(collector.changes);
+    }
+
+    /** Serve `requests` in order, and push the result of each to `sink` as soon as it is made */
+    void request(const vector<int> &requests, ChangeSink &sink)
+    {
+        this->prepare(requests);
+
+        const auto request_begin = requests.begin(),
+                   request_end = requests.end();
+        for (auto r = requests.begin(); r != request_end; ++r) {
+            this->now = r - request_begin;
+            const bool hit = this->can_hit(*r);
+
+            Page where;
+            if (hit) {
+                where = this->find_resident(*r);
+                this->touch(where - this->table.begin());
+            } else {
+                // Find where to insert / swap
+                where = this->find_idle();
+                if (where == this->table.end()) {
+                    where = this->next_to_swap(r, request_begin, request_end);
+                }
+            }
+
+            const int old_page = *where;
+            if (!hit) {
+                // insert / swap
+                this->swap(where, *r);
+            }
+
+            sink.push(this->table, where - this->table.begin(), old_page, hit);
+        }
+    }
+
+    virtual ~Manager() {}
+
+protected:
+    virtual void swap(Page where, int frame)
+    {
+        if (*where == IDLE) {
+            assert(this->idle_frames.back() == (size_t)(where - this->table.begin()));
+            this->idle_frames.pop_back();
+        }
+
+        if (this->is_small()) {
+            this->small_table[where - this->table.begin()] = frame;
+        } else {
+            if (*where != IDLE) {
+                this->residents.erase(*where);
+            }
+            this->residents[frame] = where - this->table.begin();
+        }
+
+        *where = frame;
+    }
+
+    /**
+     * @brief Find the first idle page in the page table
+     *
+     * @return PageTable::iterator `end` if none
+     */
+    Page find_idle()
+    {
+        if (this->idle_frames.empty()) {
+            return this->table.end();
+        }
+        return this->table.begin() + this->idle_frames.back();
+    }
+
+    virtual Page next_to_swap(const Request &current_request, const Request begin, const Request end) = 0;
+
+    /** Called before serving `requests` */
+    virtual void prepare(const vector<int> &requests) {}
+
+    /** Called when the request hits the frame at index `frame` of `table` */
+    virtual void touch(size_t frame) {}
+
+    /** @return PageTable::iterator `end` if `page` is not resident */
+    Page find_resident(int page)
+    {
+        if (this->is_small()) {
+            return find(this->table.begin(), this->table.end(), page);
+        }
+
+        const auto r = this->residents.find(page);
+        return r == this->residents.end() ? this->table.end() : this->table.begin() + r->second;
+    }
+
+    bool can_hit(int request)
+    {
+        if (this->is_small()) {
+            // A fixed length and no early exit, so that the loop can be vectorized.
+            int found = 0;
+            for (auto &&p : this->small_table) {
+                found |= p == request;
+            }
+            return found;
+        }
+
+        return this->residents.count(request) > 0;
+    }
+
+    bool is_small() const
+    {
+        return this->table.size() <= SMALL_TABLE;
+    }
+};
+
+/**
+ * @brief Frames in the order they were loaded, in a ring buffer that never allocates after construction
+ *
+ * Each load also stamps the frame with the number of loads before,
+ * which orders frames by load time even if they are not taken out in order.
+ */
+class LoadOrder
+{
+protected:
+    /** indices of frames, its size is the number of frames */
+    vector<size_t> ring;
+    /** where the first frame is in `ring` */
+    size_t head;
+    size_t n_queued;
+    /** for each frame, the number of loads before its last load */
+    vector<unsigned long long> stamps;
+    unsigned long long n_loaded;
+
+public:
+    LoadOrder(size_t n_frames) : ring(n_frames), head(0), n_queued(0), stamps(n_frames, 0), n_loaded(0) {}
+
+    /** Stamp `frame` as loaded now, and queue it last */
+    void push_back(size_t frame)
+    {
+        assert(this->n_queued < this->ring.size());
+        this->ring[(this->head + this->n_queued) % this->ring.size()] = frame;
+        this->n_queued++;
+        this->stamp(frame);
+    }
+
+    /** the frame loaded first */
+    size_t front() const
+    {
+        assert(this->n_queued > 0);
+        return this->ring[this->head];
+    }
+
+    void pop_front()
+    {
+        assert(this->n_queued > 0);
+        this->head = (this->head + 1) % this->ring.size();
+        this->n_queued--;
+    }
+
+    /** Stamp `frame` as loaded now, without queuing it */
+    void stamp(size_t frame)
+    {
+        this->stamps[frame] = this->n_loaded;
+        this->n_loaded++;
+    }
+
+    /** Compare it between frames to tell which was loaded first */
+    unsigned long long loaded_at(size_t frame) const
+    {
+        return this->stamps[frame];
+    }
+};
+
+class ManagerFIFO : public Manager
+{
+protected:
+    LoadOrder history;
+
+public:
+    ManagerFIFO(unsigned int n_frames) : Manager(n_frames), history(n_frames) {}
+
+protected:
+    virtual Page next_to_swap(const Request &current_request, const Request begin, const Request end)
+    {
+        return this->table.begin() + this->history.front();
+    }
+
+    virtual void swap(Page where, int frame)
+    {
+        const size_t f = where - this->table.begin();
+        if (*where != IDLE) {
+            // The victim is always the first loaded.
+            assert(this->history.front() == f);
+            this->history.pop_front();
+        }
+
+        Manager::swap(where, frame);
+        this->history.push_back(f);
+    }
+};
+
+/**
+ * @brief Belady's optimal replacement
+ *
+ * The victim is the page requested again the latest, or never.
+ * Ties (pages never requested again) go to the one loaded first, according to `ManagerFIFO::history`.
+ * Victims are not the first loaded in general, so frames are only stamped in `history` but not queued.
+ *
+ * The next use of every request is precomputed in one backward pass,
+ * and resident frames are kept in a max-heap `victims` by their next use, so a fault costs O(log frames).
+ */
+class ManagerOptimal : public ManagerFIFO
+{
+protected:
+    struct Victim {
+        /** the index of the next request of the page, `next_use.size()` if never */
+        size_t next_use;
+        /** `history.loaded_at` the frame */
+        unsigned long long loaded;
+        /** its index in `table` */
+        size_t frame;
+
+        /** whether `this` should be swapped after `other` */
+        bool operator<(const Victim &other) const
+        {
+            if (this->next_use != other.next_use) {
+                return this->next_use < other.next_use;
+            }
+            return this->loaded > other.loaded;
+        }
+
+        bool operator==(const Victim &other) const
+        {
+            return this->next_use == other.next_use && this->loaded == other.loaded && this->frame == other.frame;
+        }
+    };
+
+    /** for each request, the index of the next request of the same page, `next_use.size()` if none */
+    vector<size_t> next_use;
+    /**
+     * resident frames, the first to swap on the top
+     *
+     * A hit pushes a new entry rather than updating the old one.
+     * The old entry's next use is the hit itself, earlier than any resident page's, so it never reaches the top
+     * and is only dropped by `compact`.
+     */
+    priority_queue<Victim> victims;
+    /** each frame's entry in `victims`, if resident */
+    vector<Victim> frames;
+
+public:
+    ManagerOptimal(unsigned int n_frames) : ManagerFIFO(n_frames), frames(n_frames) {}
+
+protected:
+    void prepare(const vector<int> &requests)
+    {
+        const size_t never = requests.size();
+        this->next_use.assign(requests.size(), never);
+
+        // page → the index of its first request after the current one
+        unordered_map<int, size_t> first_use;
+        for (size_t i = requests.size(); i-- > 0;) {
+            const auto it = first_use.find(requests[i]);
+            if (it != first_use.end()) {
+                this->next_use[i] = it->second;
+                it->second = i;
+            } else {
+                first_use.emplace(requests[i], i);
+            }
+        }
+
+        // Re-key pages left by earlier requests.
+        for (size_t f = 0; f < this->table.size(); f++) {
+            if (this->table[f] != IDLE) {
+                const auto it = first_use.find(this->table[f]);
+                this->frames[f].next_use = it != first_use.end() ? it->second : never;
+            }
+        }
+        this->compact();
+    }
+
+    Page next_to_swap(const Request &current_request, const Request begin, const Request end)
+    {
+        assert(this->victims.top() == this->frames[this->victims.top().frame]);
+        return this->table.begin() + this->victims.top().frame;
+    }
+
+    void swap(Page where, int frame)
+    {
+        const size_t f = where - this->table.begin();
+        if (*where != IDLE) {
+            assert(this->victims.top().frame == f);
+            this->victims.pop();
+        }
+
+        Manager::swap(where, frame);
+        this->history.stamp(f);
+
+        this->frames[f] = Victim{this->next_use[this->now], this->history.loaded_at(f), f};
+        this->victims.push(this->frames[f]);
+    }
+
+    void touch(size_t f)
+    {
+        this->frames[f].next_use = this->next_use[this->now];
+        this->victims.push(this->frames[f]);
+
+        if (this->victims.size() > 2 * this->table.size()) {
+            this->compact();
+        }
+    }
+
+    /** Rebuild `victims` from `frames`, dropping outdated entries */
+    void compact()
+    {
+        vector<Victim> resident;
+        resident.reserve(this->table.size());
+        for (size_t f = 0; f < this->table.size(); f++) {
+            if (this->table[f] != IDLE) {
+                resident.push_back(this->frames[f]);
+            }
+        }
+        this->victims = priority_queue<Victim>(less<Victim>(), move(resident));
+    }
+};
+
+/**
+ * @brief Least recently used replacement
+ *
+ * Resident frames are linked in a recency list, so both a hit and a fault cost O(1),
+ * and the memory is bounded by the number of frames.
+ */
+class ManagerLeastRecentlyUsed : public Manager
+{
+protected:
+    /**
+     * @brief Links of the recency list, indexed by frame
+     *
+     * Index `table.size()` is the sentinel: its `next` is the least recently used frame, and its `prev` the most.
+     */
+    vector<size_t> prev, next;
+
+public:
+    ManagerLeastRecentlyUsed(unsigned int n_frames) : Manager(n_frames), prev(n_frames + 1, n_frames), next(n_frames + 1, n_frames) {}
+
+protected:
+    Page next_to_swap(const Request &current_request, const Request begin, const Request end)
+    {
+        return this->table.begin() + this->next[this->sentinel()];
+    }
+
+    void swap(Page where, int frame)
+    {
+        const size_t f = where - this->table.begin();
+        if (*where != IDLE) {
+            this->unlink(f);
+        }
+
+        Manager::swap(where, frame);
+        this->link_last(f);
+    }
+
+    void touch(size_t f)
+    {
+        this->unlink(f);
+        this->link_last(f);
+    }
+
+    size_t sentinel() const
+    {
+        return this->table.size();
+    }
+
+    void unlink(size_t f)
+    {
+        this->next[this->prev[f]] = this->next[f];
+        this->prev[this->next[f]] = this->prev[f];
+    }
+
+    /** Make `f` the most recently used */
+    void link_last(size_t f)
+    {
+        const auto last = this->prev[this->sentinel()];
+        this->prev[f] = last;
+        this->next[f] = this->sentinel();
+        this->next[last] = f;
+        this->prev[this->sentinel()] = f;
+    }
+};
+
+/** @return `nullptr` if `policy` is unknown */
+inline Manager *make_manager(Policy policy, unsigned int n_frames)
+{
+    switch (policy) {
+    case Policy::FirstInFirstOut:
+        return new ManagerFIFO(n_frames);
+    case Policy::Optimal:
+        return new ManagerOptimal(n_frames);
+    case Policy::LeastRecentlyUsed:
+        return new ManagerLeastRecentlyUsed(n_frames);
+
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,71 @@
+#include <memory>
+#include <new>
+
+#include "manager.hpp"
+#include "paging_api.h"
+
+using namespace std;
+
+static_assert(PAGING_IDLE == IDLE, "`PAGING_IDLE` should match `IDLE`");
+
+struct paging_result {
+    unsigned int n_frames;
+    vector<PageChange> changes;
+    size_t n_faults;
+};
+
+int paging_api_version(void)
+{
+    return PAGING_API_VERSION;
+}
+
+paging_result *paging_run(int policy, unsigned int n_frames, const int *pages, size_t n_pages)
+{
+    if (policy < Policy::Optimal || policy > Policy::LeastRecentlyUsed || n_frames == 0 ||
+        (pages == NULL && n_pages > 0)) {
+        return NULL;
+    }
+
+    try {
+        unique_ptr<Manager> manager(make_manager((Policy)policy, n_frames));
+        const vector<int> requests(pages, pages + n_pages);
+
+        unique_ptr<paging_result> result(new paging_result{n_frames, manager->request(requests), 0});
+        for (auto &&c : result->changes) {
+            result->n_faults += !c.hit;
+        }
+        return result.release();
+    } catch (const bad_alloc &) {
+        return NULL;
+    }
+}
+
+size_t paging_result_size(const paging_result *result)
+{
+    return result != NULL ? result->changes.size() : 0;
+}
+
+unsigned int paging_result_n_frames(const paging_result *result)
+{
+    return result != NULL ? result->n_frames : 0;
+}
+
+const int *paging_result_table(const paging_result *result, size_t i)
+{
+    return result != NULL && i < result->changes.size() ? result->changes[i].table.data() : NULL;
+}
+
+int paging_result_hit(const paging_result *result, size_t i)
+{
+    return result != NULL && i < result->changes.size() && result->changes[i].hit;
+}
+
+size_t paging_result_n_faults(const paging_result *result)
+{
+    return result != NULL ? result->n_faults : 0;
+}
+
+void paging_result_free(paging_result *result)
+{
+    delete result;
+}
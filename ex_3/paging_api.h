@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * @file
+ * @brief A C interface to the page managers in `manager.hpp`, for running many simulations in one process
+ *
+ * Build it as a shared library:
+ *
+ * ```shell
+ * g++ -std=c++17 -O2 -shared -fPIC -o libpaging.so paging_api.cpp
+ * ```
+ *
+ * Functions returning pointers return `NULL` on invalid arguments or allocation failures,
+ * and accessors of a `NULL` result return `NULL` or 0.
+ * There is no global state, so different results can be used from different threads.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Increased whenever the interface changes incompatibly */
+#define PAGING_API_VERSION 1
+
+/** Policies, the same as the first line of the text input */
+enum {
+    PAGING_OPTIMAL = 1,
+    PAGING_FIRST_IN_FIRST_OUT = 2,
+    PAGING_LEAST_RECENTLY_USED = 3,
+};
+
+/** A frame in a page table that holds no page */
+#define PAGING_IDLE -1
+
+typedef struct paging_result paging_result;
+
+/** `PAGING_API_VERSION` of the library, to be compared with the header's */
+int paging_api_version(void);
+
+/** Serve `pages` in order with `n_frames` frames */
+paging_result *paging_run(int policy, unsigned int n_frames, const int *pages, size_t n_pages);
+
+/** the number of requests served */
+size_t paging_result_size(const paging_result *result);
+unsigned int paging_result_n_frames(const paging_result *result);
+/** the page table after the `i`-th request: `n_frames` pages, `PAGING_IDLE` for idle frames */
+const int *paging_result_table(const paging_result *result, size_t i);
+/** whether the `i`-th request hit */
+int paging_result_hit(const paging_result *result, size_t i);
+size_t paging_result_n_faults(const paging_result *result);
+void paging_result_free(paging_result *result);
+
+#ifdef __cplusplus
+}
+#endif